@@ -0,0 +1,1025 @@
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "amx_gemm.h"
+#include "amx_perf.h"
+#include "amx_quantize.h"
+#include "amx_roofline.h"
+#include "amx_stream.h"
+#include "amx_thread_pool.h"
+#include "amx_tutorial.h"
+#include "amx_verify.h"
+#include "amx_weight_file.h"
+
+// 统一的基准测试程序, 取代第1~5版示例中写死的循环次数、线程数和单次墙钟计时:
+// 线程池在计时前创建并预热, 每个样本连续调用若干次, 报告每次调用耗时的最小值/中位数/p99
+// 和 GOPS, 可以输出 JSON/CSV 供脚本收集
+static const char *USAGE = R"(用法: amx_bench [选项]
+  --variant NAME   v1 v2 v3 v4 v5 (教程中的各版内核) 或 gemm batched bf16 qlinear stream,
+                   默认 gemm; qlinear 为 fp32 输入输出的 QuantizedLinear (动态量化 + int8 GEMM
+                   + 反量化); stream 为 A 在文件中的 int8 流式 GEMM (默认 65536x1024x1024)
+  --shape MxNxK    gemm/bf16/qlinear 的形状 (默认 384x1000x768), batched 中每个问题的形状
+                   (默认 16x64x64); v3/v4/v5 只使用 K (默认 1024), M/N 由内核决定
+  --threads N      线程数, 默认 1 (v5 默认使用全部 CPU)
+  --warmup N       计时前的预热调用次数, 默认 10
+  --reps N         计时样本数, 默认 100
+  --calls N        每个样本连续调用的次数, 默认 0 (自动选择, 使每个样本不短于 200us)
+  --layout L       B 的布局: tiles (16x64 字节小矩阵的数组, v1~v5)、vnni (行跨度 VNNI,
+                   v4/v5/gemm/bf16/batched)、packed (预打包的 tile, gemm/bf16) 或 mapped
+                   (预打包后写成权重文件再 mmap, gemm/bf16), 默认按变体选择
+  --weights-file P mapped 布局使用的权重文件, 默认 /tmp/amx_bench_weights.bin
+  --stream-file P  stream 的 A 文件 (不存在或大小不符时生成), C 写入 P.c;
+                   默认 /tmp/amx_bench_stream_a.bin
+  --panel-rows R   stream 每块的行数, 默认 0 (自动, A 的一块约 64MB)
+  --a-layout L     gemm/bf16 中 A 的布局: row (行主序) 或 tile (tile 主序, 每个 16x64 字节的
+                   tile 为连续的 1KB 块, 只支持 packed 布局的 B), 默认 row
+  --batch N        batched 的问题个数, 默认 4096
+  --kernel MRxNR   AMX 内核的寄存器分块 (同 AMX_GEMM_KERNEL)
+  --prefetch D     AMX 内核的预取距离 (同 AMX_GEMM_PREFETCH)
+  --split-k S      gemm/bf16 多线程时按 K 切分的片数: 0 自动 (C 的 tile 少于线程数时切分),
+                   1 不切分, >= 2 强制切分, 默认 0
+  --gemv-max-m N   gemm/bf16 的 M 不超过 N 时 AMX 后端改用 AVX-512 GEMV 内核, 0 关闭,
+                   默认使用库的设置
+  --sweep-m LIST   依次测量逗号分隔的多个 M (如 1,2,4,8,16), N、K 取 --shape (默认 4096),
+                   用于比较小 M 的延迟; csv 只输出一次表头
+  --format F       输出格式: text、json 或 csv, 默认 text
+  --no-header      csv 不输出表头, 便于追加到已有文件
+  --counters       用 perf_event_open 统计计时区间内所有线程的周期、指令、L1D/L2/LLC 缺失、
+                   dTLB 缺失和 AMX 事件 (Sapphire Rapids), 报告每次调用和每 GOP 的值
+  --roofline       计时后用微基准测量 TMUL 峰值、tile 加载带宽和内存带宽, 按 tile 指令的
+                   读写字节和最少内存字节计算强度, 报告本次运行在屋顶线上的位置
+  --verify         不计时, 在随机形状和数据上验证所有后端、分块、线程池、后处理、批量接口
+                   和第1~5版内核的结果; --threads 为线程池大小 (默认 4)
+  --cases N        --verify 中每组检查的随机问题个数, 默认 24
+  --seed S         --verify 的随机种子, 默认 1
+)";
+
+struct BenchOptions {
+    std::string variant = "gemm";
+    int m = 0, n = 0, k = 0;  // 0 表示使用变体的默认形状
+    int threads = -1;         // -1 表示使用变体的默认线程数
+    int warmup = 10;
+    int reps = 100;
+    int calls = 0;
+    std::string layout;
+    std::string a_layout = "row";
+    std::string weights_file = "/tmp/amx_bench_weights.bin";
+    std::string stream_file = "/tmp/amx_bench_stream_a.bin";
+    int panel_rows = 0;
+    int batch = 4096;
+    GemmKernelShape kernel{0, 0};
+    int prefetch = PREFETCH_AUTO - 1;  // 小于 PREFETCH_AUTO 表示不覆盖
+    int split_k = 0;
+    int gemv_max_m = -1;  // 小于 0 表示不覆盖
+    std::vector<int> sweep_m;
+    std::string format = "text";
+    bool header = true;
+    bool counters = false;
+    bool roofline = false;
+    bool verify = false;
+    int cases = 24;
+    uint32_t seed = 1;
+};
+
+// 一个待测的用例: 形状、每次调用的运算次数 (乘加计 2 次)、读写的字节数和执行 calls 次调用的函数
+struct BenchCase {
+    int m = 0, n = 0, k = 0;
+    int64_t ops = 0;
+    TileTraffic traffic;    // AMX 后端每次调用的 tile 指令流量, 其它后端为空
+    int64_t min_bytes = 0;  // 每次调用至少要读写的字节数 (A、B 读一次, C 写一次)
+    bool bf16 = false;
+    std::string backend;
+    std::string kernel;
+    std::string layout;
+    int threads = 1;
+    int split_k = 1;  // 按 K 切分的片数
+    std::function<void(int)> run;
+    std::function<std::string()> summary;  // 可选, 变体自己的统计 (只在 text 格式中输出)
+};
+
+struct BenchResult {
+    int calls = 0;
+    double min_us = 0, median_us = 0, p99_us = 0;
+    double gops = 0, peak_gops = 0;
+    TileConfigStats tile_config;        // 所有样本中所有线程的 tile 配置统计
+    std::vector<PerfReading> counters;  // 所有样本的累计值
+    double counted_calls = 0;           // 计数期间的调用次数
+    RooflineCeilings ceilings;          // --roofline
+    RooflinePoint roofline;
+};
+
+static bool ParseShape(const char *text, BenchOptions &opt) {
+    return std::sscanf(text, "%dx%dx%d", &opt.m, &opt.n, &opt.k) == 3 && opt.m > 0 &&
+           opt.n > 0 && opt.k > 0;
+}
+
+static bool ParseArgs(int argc, char **argv, BenchOptions &opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string key = argv[i];
+        std::string value;
+        const size_t eq = key.find('=');
+        if (eq != std::string::npos) {
+            value = key.substr(eq + 1);
+            key = key.substr(0, eq);
+        } else if (key == "--no-header") {
+            opt.header = false;
+            continue;
+        } else if (key == "--counters") {
+            opt.counters = true;
+            continue;
+        } else if (key == "--roofline") {
+            opt.roofline = true;
+            continue;
+        } else if (key == "--verify") {
+            opt.verify = true;
+            continue;
+        } else if (key == "--help" || key == "-h") {
+            return false;
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            std::cerr << "缺少参数值: " << key << "\n";
+            return false;
+        }
+
+        if (key == "--variant") {
+            opt.variant = value;
+        } else if (key == "--shape") {
+            if (!ParseShape(value.c_str(), opt)) {
+                std::cerr << "形状须为 MxNxK: " << value << "\n";
+                return false;
+            }
+        } else if (key == "--threads") {
+            opt.threads = std::atoi(value.c_str());
+        } else if (key == "--warmup") {
+            opt.warmup = std::max(0, std::atoi(value.c_str()));
+        } else if (key == "--reps") {
+            opt.reps = std::max(1, std::atoi(value.c_str()));
+        } else if (key == "--calls") {
+            opt.calls = std::max(0, std::atoi(value.c_str()));
+        } else if (key == "--layout") {
+            opt.layout = value;
+        } else if (key == "--stream-file") {
+            opt.stream_file = value;
+        } else if (key == "--panel-rows") {
+            opt.panel_rows = std::max(0, std::atoi(value.c_str()));
+        } else if (key == "--weights-file") {
+            opt.weights_file = value;
+        } else if (key == "--a-layout") {
+            opt.a_layout = value;
+        } else if (key == "--batch") {
+            opt.batch = std::max(1, std::atoi(value.c_str()));
+        } else if (key == "--kernel") {
+            if (std::sscanf(value.c_str(), "%dx%d", &opt.kernel.mr, &opt.kernel.nr) != 2) {
+                std::cerr << "分块须为 MRxNR: " << value << "\n";
+                return false;
+            }
+        } else if (key == "--prefetch") {
+            opt.prefetch = std::max(PREFETCH_AUTO, std::atoi(value.c_str()));
+        } else if (key == "--split-k") {
+            opt.split_k = std::max(0, std::atoi(value.c_str()));
+        } else if (key == "--gemv-max-m") {
+            opt.gemv_max_m = std::max(0, std::atoi(value.c_str()));
+        } else if (key == "--sweep-m") {
+            std::stringstream list(value);
+            for (std::string item; std::getline(list, item, ',');) {
+                const int m = std::atoi(item.c_str());
+                if (m <= 0) {
+                    std::cerr << "M 须为正整数: " << item << "\n";
+                    return false;
+                }
+                opt.sweep_m.push_back(m);
+            }
+        } else if (key == "--format") {
+            opt.format = value;
+        } else if (key == "--cases") {
+            opt.cases = std::max(1, std::atoi(value.c_str()));
+        } else if (key == "--seed") {
+            opt.seed = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+        } else {
+            std::cerr << "未知选项: " << key << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// 与 --verify 使用相同的随机数据 (混有极值)
+template <typename DataType>
+static void FillRandom(Matrix<DataType> &matrix, std::mt19937 &rng) {
+    for (int i = 0; i < matrix.Size(); ++i) matrix.Data()[i] = RandomElement<DataType>(rng);
+}
+
+static std::string KernelName(GemmKernelShape shape) {
+    if (shape.mr == 0 && shape.nr == 0) return "auto";
+    return std::to_string(shape.mr) + "x" + std::to_string(shape.nr);
+}
+
+// ---------------- 第1~5版的教程内核 ----------------
+
+// 每个线程独立的一份数据: k_tiles 个 16x64 字节的 A/B 小矩阵 (tiles 布局),
+// 以及同样内容的 16 x K 行块和 (K / 4) x 64 字节的 VNNI 列块 (vnni 布局)
+struct TutorialData {
+    std::vector<Matrix<int8_t>> VA0, VA1, VB0, VB1;
+    Matrix<int8_t> A0, A1, B0, B1;
+    Matrix<int32_t> C00{TILE_ROWS, TILE_ROWS}, C01{TILE_ROWS, TILE_ROWS};
+    Matrix<int32_t> C10{TILE_ROWS, TILE_ROWS}, C11{TILE_ROWS, TILE_ROWS};
+
+    TutorialData(int k_tiles, std::mt19937 &rng)
+        : A0(TILE_ROWS, k_tiles * TILE_COLSB),
+          A1(TILE_ROWS, k_tiles * TILE_COLSB),
+          B0(k_tiles * TILE_ROWS, TILE_COLSB),
+          B1(k_tiles * TILE_ROWS, TILE_COLSB) {
+        for (auto *v : {&VA0, &VA1, &VB0, &VB1}) {
+            v->reserve(k_tiles);
+            for (int t = 0; t < k_tiles; ++t) {
+                v->emplace_back(TILE_ROWS, TILE_COLSB);
+                FillRandom(v->back(), rng);
+            }
+        }
+        for (int t = 0; t < k_tiles; ++t) {
+            for (int r = 0; r < TILE_ROWS; ++r) {
+                const size_t a = static_cast<size_t>(r) * A0.Cols() + t * TILE_COLSB;
+                const size_t b = static_cast<size_t>(t * TILE_ROWS + r) * TILE_COLSB;
+                std::memcpy(A0.Data() + a, VA0[t].Data() + r * TILE_COLSB, TILE_COLSB);
+                std::memcpy(A1.Data() + a, VA1[t].Data() + r * TILE_COLSB, TILE_COLSB);
+                std::memcpy(B0.Data() + b, VB0[t].Data() + r * TILE_COLSB, TILE_COLSB);
+                std::memcpy(B1.Data() + b, VB1[t].Data() + r * TILE_COLSB, TILE_COLSB);
+            }
+        }
+        for (auto *c : {&C00, &C01, &C10, &C11}) c->Fill(0);
+    }
+};
+
+// 第1~3版的内核与教程源文件共用 (amx_tutorial.h); 第4/5版的内核即库中保留的第5版接口
+// (tiles 布局) 及其视图版本 (vnni 布局)
+static std::function<void(TutorialData &)> TutorialKernel(const std::string &v, bool vnni) {
+    if (v == "v1") return [](TutorialData &d) { MatrixMultiplyV1(d.VA0[0], d.VB0[0], d.C00); };
+    if (v == "v2") {
+        return [](TutorialData &d) {
+            MatrixMultiplyV2(d.VA0[0], d.VA1[0], d.VB0[0], d.VB1[0], d.C00, d.C01, d.C10, d.C11);
+        };
+    }
+    if (v == "v3") return [](TutorialData &d) { MatrixMultiplyV3(d.VA0, d.VB0, d.C00); };
+    auto multiply = std::make_shared<IntelAmxMatrixMultiply<int8_t, int32_t>>(
+        IntelAmxMatrixMultiply<int8_t, int32_t>::Create());
+    if (vnni) {
+        return [multiply](TutorialData &d) {
+            multiply->MatrixMultiply(d.A0.View(), d.A1.View(), d.B0.View(), d.B1.View(),
+                                     d.C00.View(), d.C01.View(), d.C10.View(), d.C11.View());
+        };
+    }
+    return [multiply](TutorialData &d) {
+        multiply->MatrixMultiply(d.VA0, d.VA1, d.VB0, d.VB1, d.C00, d.C01, d.C10, d.C11);
+    };
+}
+
+static BenchCase TutorialCase(const BenchOptions &opt, std::unique_ptr<WorkerPool> &pool) {
+    BenchCase bc;
+    const std::string &v = opt.variant;
+    const bool two_by_two = v == "v2" || v == "v4" || v == "v5";
+    const bool k_loop = v == "v3" || v == "v4" || v == "v5";
+    const int k = k_loop ? (opt.k > 0 ? opt.k : 1024) : TILE_COLSB;
+    if (k % TILE_COLSB != 0) throw std::invalid_argument("K 须为 64 的倍数");
+    bc.layout = opt.layout.empty() ? "tiles" : opt.layout;
+    const bool vnni = bc.layout == "vnni";
+    if (!vnni && bc.layout != "tiles") throw std::invalid_argument("不支持的布局: " + bc.layout);
+    if (vnni && v != "v4" && v != "v5") throw std::invalid_argument("vnni 布局只适用于 v4/v5");
+    if (!GetCpuFeatures().amx_int8 || !RequestAmxPermission()) {
+        throw std::runtime_error("第1~5版内核需要 AMX-INT8");
+    }
+
+    bc.m = two_by_two ? 2 * TILE_ROWS : TILE_ROWS;
+    bc.n = bc.m;
+    bc.k = k;
+    bc.ops = int64_t(bc.m) * bc.n * bc.k * 2;
+    bc.backend = GemmBackendName(GemmBackend::AMX);
+    bc.kernel = two_by_two ? "2x2" : "1x1";
+
+    // 各版都是在开头加载 C、沿 K 累加、结尾存回的 1x1 或 2x2 分块, 第1/2版只有一个 K tile
+    const int tile[2] = {TILE_ROWS, TILE_ROWS};
+    AddKernelTraffic(tile, two_by_two ? 2 : 1, tile, two_by_two ? 2 : 1, TILE_COLSB,
+                     k / TILE_COLSB, true, bc.traffic);
+    bc.min_bytes = int64_t(bc.m + bc.n) * k + int64_t(bc.m) * bc.n * 4 * 2;  // C 读写各一次
+
+    const int threads = opt.threads >= 0 ? opt.threads : (v == "v5" ? 0 : 1);
+    if (threads != 1) pool = std::make_unique<WorkerPool>(threads);
+    bc.threads = pool ? pool->Size() : 1;
+
+    std::mt19937 rng(2024);
+    auto data = std::make_shared<std::vector<TutorialData>>();
+    data->reserve(bc.threads);
+    for (int t = 0; t < bc.threads; ++t) data->emplace_back(k / TILE_COLSB, rng);
+
+    const std::function<void(TutorialData &)> kernel = TutorialKernel(v, vnni);
+
+    // 多线程时每个线程在自己的数据上连续调用, 一次"调用"指所有线程各完成一次
+    WorkerPool *p = pool.get();
+    bc.ops *= bc.threads;
+    bc.traffic *= bc.threads;
+    bc.min_bytes *= bc.threads;
+    bc.run = [data, kernel, p](int calls) {
+        auto body = [&](int t, int) {
+            LoadTutorialConfig();
+            TutorialData &d = (*data)[t];
+            for (int i = 0; i < calls; ++i) kernel(d);
+        };
+        if (p) {
+            p->Run(p->Size(), body);
+        } else {
+            body(0, 0);
+        }
+    };
+    return bc;
+}
+
+// ---------------- 库接口 ----------------
+
+template <typename InputType, typename OutputType>
+static IntelAmxMatrixMultiply<InputType, OutputType> CreateMultiply(const BenchOptions &opt,
+                                                                   BenchCase &bc) {
+    auto multiply = IntelAmxMatrixMultiply<InputType, OutputType>::Create();
+    if (opt.kernel.mr != 0 || opt.kernel.nr != 0) multiply.SetKernel(opt.kernel);
+    if (opt.prefetch >= PREFETCH_AUTO) multiply.SetPrefetchDistance(opt.prefetch);
+    multiply.SetSplitK(opt.split_k);
+    if (opt.gemv_max_m >= 0) multiply.SetGemvMaxM(opt.gemv_max_m);
+    bc.backend = GemmBackendName(multiply.Backend());
+    bc.kernel = multiply.Backend() == GemmBackend::AMX ? KernelName(multiply.Kernel()) : "-";
+    return multiply;
+}
+
+// gemm / bf16: 一次调用为一个 M x N x K 的 GEMM, 多线程时由线程池共同完成
+template <typename InputType, typename OutputType>
+static BenchCase GemmCase(const BenchOptions &opt, std::unique_ptr<WorkerPool> &pool) {
+    constexpr int G = VNNI_GROUP<InputType>;
+    BenchCase bc;
+    bc.m = opt.m > 0 ? opt.m : 384;
+    bc.n = opt.m > 0 ? opt.n : 1000;
+    bc.k = opt.m > 0 ? opt.k : 768;
+    bc.ops = int64_t(bc.m) * bc.n * bc.k * 2;
+    bc.layout = opt.layout.empty() ? "packed" : opt.layout;
+    const bool mapped = bc.layout == "mapped";
+    const bool packed = bc.layout == "packed" || mapped;
+    if (!packed && bc.layout != "vnni") throw std::invalid_argument("不支持的布局: " + bc.layout);
+    const bool tile_a = opt.a_layout == "tile";
+    if (!tile_a && opt.a_layout != "row") {
+        throw std::invalid_argument("不支持的 A 布局: " + opt.a_layout);
+    }
+    if (tile_a && !packed) throw std::invalid_argument("tile 主序的 A 只支持 packed 布局的 B");
+    if (tile_a) bc.layout += "/tile_a";
+
+    const int threads = opt.threads >= 0 ? opt.threads : 1;
+    if (threads != 1) pool = std::make_unique<WorkerPool>(threads);
+    bc.threads = pool ? pool->Size() : 1;
+
+    struct Data {
+        Matrix<InputType> A, B;
+        Matrix<OutputType> C;
+        std::unique_ptr<PackedB<InputType>> packed;
+        IntelAmxMatrixMultiply<InputType, OutputType> multiply;
+        MappedWeights<InputType> weights;  // mapped 布局: packed 引用其中的数据
+    };
+    std::mt19937 rng(2024);
+    const int m = bc.m, n = bc.n, k = bc.k;
+    auto d = std::make_shared<Data>(Data{Matrix<InputType>(m, k),
+                                         Matrix<InputType>((k + G - 1) / G, n * G),
+                                         Matrix<OutputType>(m, n), nullptr,
+                                         CreateMultiply<InputType, OutputType>(opt, bc),
+                                         MappedWeights<InputType>()});
+    FillRandom(d->A, rng);
+    FillRandom(d->B, rng);
+    bc.split_k = d->multiply.ChooseSplitK(m, n, k, bc.threads);
+    const bool gemv = d->multiply.Backend() == GemmBackend::AMX && m <= d->multiply.GemvMaxM();
+    if (gemv) bc.kernel = "gemv";  // 不使用 tile 指令, 屋顶线中没有 tile 流量
+    for (int s = 0; s < bc.split_k && d->multiply.Backend() == GemmBackend::AMX && !gemv; ++s) {
+        const auto [k0, k1] = IntelAmxMatrixMultiply<InputType, OutputType>::SplitKSlice(
+            k, bc.split_k, s);
+        bc.traffic += GemmTileTraffic(m, n, k1 - k0, sizeof(InputType), d->multiply.Kernel());
+    }
+    bc.min_bytes = (int64_t(m) * k + int64_t(n) * ((k + G - 1) / G * G)) * sizeof(InputType) +
+                   int64_t(m) * n * sizeof(OutputType);
+    bc.bf16 = std::is_same_v<InputType, bfloat16>;
+    if (packed) {
+        // 打包接受行主序的 K x N 矩阵, 这里直接把随机数据当作行主序的 B
+        Matrix<InputType> B(k, n);
+        FillRandom(B, rng);
+        d->packed = std::make_unique<PackedB<InputType>>(k, n, B.Data(), n);
+    }
+    if (mapped) {
+        // 计时的是映射后的 Gemm: 数据在页缓存中, 使用 4KB 页 (不是 PackedB 的大页)
+        std::string error;
+        if (!SaveWeightFile(opt.weights_file, *d->packed, nullptr, &error) ||
+            !d->weights.Open(opt.weights_file, &error, true)) {
+            throw std::runtime_error(error);
+        }
+        const PackedB<InputType> &w = d->weights.Packed();
+        d->packed = std::make_unique<PackedB<InputType>>(
+            PackedB<InputType>::Wrap(k, n, w.Data(), w.ColumnSums()));
+    }
+    if (tile_a) d->A = ConvertLayout(d->A, MatrixLayout::TILE_MAJOR);  // 转换只做一次, 不计时
+
+    WorkerPool *p = pool.get();
+    bc.run = [d, p, m, n, k](int calls) {
+        for (int i = 0; i < calls; ++i) {
+            if (d->A.Layout() == MatrixLayout::TILE_MAJOR && p) {
+                d->multiply.Gemm(d->A, *d->packed, d->C.Data(), n, *p);
+            } else if (d->A.Layout() == MatrixLayout::TILE_MAJOR) {
+                d->multiply.Gemm(d->A, *d->packed, d->C.Data(), n);
+            } else if (d->packed && p) {
+                d->multiply.Gemm(m, d->A.Data(), k, *d->packed, d->C.Data(), n, *p);
+            } else if (d->packed) {
+                d->multiply.Gemm(m, d->A.Data(), k, *d->packed, d->C.Data(), n);
+            } else if (p) {
+                d->multiply.Gemm(m, n, k, d->A.Data(), k, d->B.Data(), n * G, d->C.Data(), n,
+                                 *p);
+            } else {
+                d->multiply.Gemm(m, n, k, d->A.Data(), k, d->B.Data(), n * G, d->C.Data(), n);
+            }
+        }
+    };
+    return bc;
+}
+
+// qlinear: 一次调用为一次 QuantizedLinear::Forward, 计时包括 X 的量化和输出的反量化;
+// 与同一形状的 gemm 对比即为量化前端的开销。--layout 选择激活的量化粒度: row 或 tensor
+static BenchCase QuantizedLinearCase(const BenchOptions &opt, std::unique_ptr<WorkerPool> &pool) {
+    BenchCase bc;
+    bc.m = opt.m > 0 ? opt.m : 384;
+    bc.n = opt.m > 0 ? opt.n : 1000;
+    bc.k = opt.m > 0 ? opt.k : 768;
+    bc.ops = int64_t(bc.m) * bc.n * bc.k * 2;
+    bc.layout = opt.layout.empty() ? "row" : opt.layout;
+    if (bc.layout != "row" && bc.layout != "tensor") {
+        throw std::invalid_argument("qlinear 的量化粒度须为 row 或 tensor: " + bc.layout);
+    }
+    const int threads = opt.threads >= 0 ? opt.threads : 1;
+    if (threads != 1) pool = std::make_unique<WorkerPool>(threads);
+    bc.threads = pool ? pool->Size() : 1;
+
+    const int m = bc.m, n = bc.n, k = bc.k;
+    std::mt19937 rng(2024);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> W(static_cast<size_t>(k) * n), bias(n);
+    for (float &w : W) w = normal(rng) * 0.05f;
+    for (float &b : bias) b = normal(rng);
+    struct Data {
+        std::vector<float> X, Y;
+        QuantizedLinear linear;
+    };
+    const QuantGranularity granularity =
+        bc.layout == "row" ? QuantGranularity::PER_ROW : QuantGranularity::PER_TENSOR;
+    auto d = std::make_shared<Data>(Data{std::vector<float>(static_cast<size_t>(m) * k),
+                                         std::vector<float>(static_cast<size_t>(m) * n),
+                                         QuantizedLinear(k, n, W.data(), n, bias.data(),
+                                                         granularity)});
+    for (float &x : d->X) x = normal(rng);
+    bc.backend = GemmBackendName(d->linear.Backend());
+    bc.kernel = "-";
+    bc.min_bytes = int64_t(m) * k * sizeof(float) + int64_t(k) * n + int64_t(m) * n * sizeof(float);
+
+    WorkerPool *p = pool.get();
+    bc.run = [d, p, m, n, k](int calls) {
+        for (int i = 0; i < calls; ++i) {
+            if (p) {
+                d->linear.Forward(m, d->X.data(), k, d->Y.data(), n, *p);
+            } else {
+                d->linear.Forward(m, d->X.data(), k, d->Y.data(), n);
+            }
+        }
+    };
+    return bc;
+}
+
+// stream: 一次调用为一次完整的 StreamGemm, 从文件读入 A、把 C 写回文件。--layout 选择
+// pread 或 mmap; 文件通常在页缓存中, 测得的是计算与 I/O 重叠后的开销
+static BenchCase StreamCase(const BenchOptions &opt, std::unique_ptr<WorkerPool> &pool) {
+    BenchCase bc;
+    bc.m = opt.m > 0 ? opt.m : 65536;
+    bc.n = opt.m > 0 ? opt.n : 1024;
+    bc.k = opt.m > 0 ? opt.k : 1024;
+    bc.ops = int64_t(bc.m) * bc.n * bc.k * 2;
+    bc.layout = opt.layout.empty() ? "pread" : opt.layout;
+    if (bc.layout != "pread" && bc.layout != "mmap") {
+        throw std::invalid_argument("stream 的读取方式须为 pread 或 mmap: " + bc.layout);
+    }
+    const int threads = opt.threads >= 0 ? opt.threads : 1;
+    if (threads != 1) pool = std::make_unique<WorkerPool>(threads);
+    bc.threads = pool ? pool->Size() : 1;
+
+    const int m = bc.m, n = bc.n, k = bc.k;
+    const uint64_t a_bytes = uint64_t(m) * k;
+    struct stat st;
+    if (stat(opt.stream_file.c_str(), &st) != 0 || uint64_t(st.st_size) != a_bytes) {
+        // 按行块生成随机的 A, 不需要整个 A 的内存
+        std::FILE *f = std::fopen(opt.stream_file.c_str(), "wb");
+        if (f == nullptr) throw std::runtime_error("无法创建 " + opt.stream_file);
+        std::mt19937 rng(2024);
+        std::vector<int8_t> rows(static_cast<size_t>(std::min(m, 1024)) * k);
+        bool ok = true;
+        for (int i = 0; i < m && ok; i += 1024) {
+            const size_t bytes = static_cast<size_t>(std::min(1024, m - i)) * k;
+            for (size_t b = 0; b < bytes; ++b) rows[b] = RandomElement<int8_t>(rng);
+            ok = std::fwrite(rows.data(), 1, bytes, f) == bytes;
+        }
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok) throw std::runtime_error("写入 " + opt.stream_file + " 失败");
+    }
+
+    struct Data {
+        std::unique_ptr<PackedB<int8_t>> packed;
+        IntelAmxMatrixMultiply<int8_t, int32_t> multiply;
+        StreamGemmOptions options;
+        StreamGemmStats total;
+        int calls = 0;
+    };
+    auto d = std::make_shared<Data>(Data{nullptr, CreateMultiply<int8_t, int32_t>(opt, bc),
+                                         StreamGemmOptions{}, StreamGemmStats{}, 0});
+    Matrix<int8_t> B(k, n);
+    std::mt19937 rng(7);
+    FillRandom(B, rng);
+    d->packed = std::make_unique<PackedB<int8_t>>(k, n, B.Data(), n);
+    d->options.panel_rows = opt.panel_rows;
+    d->options.mmap_input = bc.layout == "mmap";
+    bc.min_bytes = int64_t(a_bytes) + int64_t(k) * n + int64_t(m) * n * 4;
+
+    WorkerPool *p = pool.get();
+    const std::string a_path = opt.stream_file, c_path = opt.stream_file + ".c";
+    bc.run = [d, p, m, a_path, c_path](int calls) {
+        for (int i = 0; i < calls; ++i) {
+            StreamGemmStats stats;
+            std::string error;
+            if (!StreamGemm(d->multiply, m, a_path, *d->packed, c_path, d->options, p, &stats,
+                            &error)) {
+                throw std::runtime_error(error);
+            }
+            d->total.panels = stats.panels, d->total.panel_rows = stats.panel_rows;
+            d->total.compute_us += stats.compute_us;
+            d->total.stall_us += stats.stall_us;
+            ++d->calls;
+        }
+    };
+    bc.summary = [d]() {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1) << "流式 (每次调用): " << d->total.panels
+            << " 块 x " << d->total.panel_rows << " 行, 计算 " << d->total.compute_us / d->calls
+            << " us, 等待 I/O " << d->total.stall_us / d->calls << " us";
+        return out.str();
+    };
+    return bc;
+}
+
+// batched: 一次调用为 batch 个形状相同的小 GEMM (GemmBatched), B 为 vnni 布局
+static BenchCase BatchedCase(const BenchOptions &opt, std::unique_ptr<WorkerPool> &pool) {
+    BenchCase bc;
+    bc.m = opt.m > 0 ? opt.m : 16;
+    bc.n = opt.m > 0 ? opt.n : 64;
+    bc.k = opt.m > 0 ? opt.k : 64;
+    bc.ops = int64_t(bc.m) * bc.n * bc.k * 2 * opt.batch;
+    bc.layout = opt.layout.empty() ? "vnni" : opt.layout;
+    if (bc.layout != "vnni") throw std::invalid_argument("batched 只支持 vnni 布局");
+
+    const int threads = opt.threads >= 0 ? opt.threads : 1;
+    if (threads != 1) pool = std::make_unique<WorkerPool>(threads);
+    bc.threads = pool ? pool->Size() : 1;
+
+    struct Data {
+        Matrix<int8_t> A, B;
+        Matrix<int32_t> C;
+        IntelAmxMatrixMultiply<int8_t, int32_t> multiply;
+    };
+    const int m = bc.m, n = bc.n, k = bc.k, batch = opt.batch;
+    const int kg = (k + 3) / 4;
+    auto d = std::make_shared<Data>(Data{Matrix<int8_t>(batch, m * k),
+                                         Matrix<int8_t>(batch, kg * n * 4),
+                                         Matrix<int32_t>(batch, m * n),
+                                         CreateMultiply<int8_t, int32_t>(opt, bc)});
+    std::mt19937 rng(2024);
+    FillRandom(d->A, rng);
+    FillRandom(d->B, rng);
+    if (d->multiply.Backend() == GemmBackend::AMX) {
+        bc.traffic = GemmTileTraffic(m, n, k, 1, d->multiply.Kernel());
+        bc.traffic *= batch;
+    }
+    bc.min_bytes = (int64_t(m) * k + int64_t(kg) * n * 4 + int64_t(m) * n * 4) * batch;
+
+    WorkerPool *p = pool.get();
+    bc.run = [d, p, m, n, k, kg, batch](int calls) {
+        const size_t sa = size_t(m) * k, sb = size_t(kg) * n * 4, sc = size_t(m) * n;
+        for (int i = 0; i < calls; ++i) {
+            if (p) {
+                d->multiply.GemmBatched(m, n, k, d->A.Data(), k, sa, d->B.Data(), n * 4, sb,
+                                        d->C.Data(), n, sc, batch, *p);
+            } else {
+                d->multiply.GemmBatched(m, n, k, d->A.Data(), k, sa, d->B.Data(), n * 4, sb,
+                                        d->C.Data(), n, sc, batch);
+            }
+        }
+    };
+    return bc;
+}
+
+static BenchCase MakeCase(const BenchOptions &opt, std::unique_ptr<WorkerPool> &pool) {
+    const std::string &v = opt.variant;
+    if (v == "v1" || v == "v2" || v == "v3" || v == "v4" || v == "v5") {
+        return TutorialCase(opt, pool);
+    }
+    if (v == "gemm") return GemmCase<int8_t, int32_t>(opt, pool);
+    if (v == "bf16") return GemmCase<bfloat16, float>(opt, pool);
+    if (v == "batched") return BatchedCase(opt, pool);
+    if (v == "qlinear") return QuantizedLinearCase(opt, pool);
+    if (v == "stream") return StreamCase(opt, pool);
+    throw std::invalid_argument("未知的变体: " + v);
+}
+
+// ---------------- 计时与统计 ----------------
+
+// 计数器在计时区间之外开关, 只统计 calls 次调用本身
+static double TimeCalls(const BenchCase &bc, int calls, PerfCounters *counters = nullptr) {
+    if (counters) counters->Enable();
+    const auto t0 = std::chrono::steady_clock::now();
+    bc.run(calls);
+    const auto t1 = std::chrono::steady_clock::now();
+    if (counters) counters->Disable();
+    return std::chrono::duration<double, std::micro>(t1 - t0).count();
+}
+
+static BenchResult Measure(const BenchCase &bc, const BenchOptions &opt) {
+    constexpr double MIN_SAMPLE_US = 200;
+    if (opt.warmup > 0) bc.run(opt.warmup);
+
+    // 单次调用太短时计时器的开销和精度会主导结果, 自动加倍每个样本的调用次数
+    BenchResult r;
+    r.calls = opt.calls;
+    if (r.calls == 0) {
+        r.calls = 1;
+        while (r.calls < (1 << 24) && TimeCalls(bc, r.calls) < MIN_SAMPLE_US) r.calls *= 2;
+    }
+
+    // 线程池此时已经创建, /proc/self/task 中包含全部工作线程
+    std::unique_ptr<PerfCounters> counters;
+    if (opt.counters) {
+        counters = std::make_unique<PerfCounters>(ProcessThreadIds());
+        counters->Reset();
+    }
+
+    const TileConfigStats before = AmxThreadContext::TotalStats();
+    std::vector<double> samples(opt.reps);
+    for (double &s : samples) s = TimeCalls(bc, r.calls, counters.get()) / r.calls;
+    const TileConfigStats after = AmxThreadContext::TotalStats();
+    r.tile_config.requests = after.requests - before.requests;
+    r.tile_config.loads = after.loads - before.loads;
+    r.tile_config.builds = after.builds - before.builds;
+    if (counters) {
+        r.counters = counters->Read();
+        r.counted_calls = double(r.calls) * opt.reps;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    const size_t count = samples.size();
+    r.min_us = samples.front();
+    r.median_us = count % 2 ? samples[count / 2]
+                            : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+    r.p99_us = samples[std::min(count - 1, (count * 99 + 99) / 100 - 1)];
+    r.gops = bc.ops / (r.median_us * 1e3);
+    r.peak_gops = bc.ops / (r.min_us * 1e3);
+    return r;
+}
+
+// ---------------- 正确性验证 ----------------
+
+// 一个 C tile 的参考结果: sum_t VA[t] * VB[t], VA[t] 为 16x64 的 A tile, VB[t] 为 VNNI 格式的
+// B tile (16 行, 每行 16 列 x 4 个 K)
+static std::vector<int32_t> TutorialReference(const std::vector<Matrix<int8_t>> &VA,
+                                              const std::vector<Matrix<int8_t>> &VB, int tiles) {
+    std::vector<int32_t> c(TILE_ROWS * TILE_ROWS, 0);
+    for (int t = 0; t < tiles; ++t) {
+        for (int i = 0; i < TILE_ROWS; ++i) {
+            for (int j = 0; j < TILE_ROWS; ++j) {
+                for (int k = 0; k < TILE_COLSB; ++k) {
+                    c[i * TILE_ROWS + j] += int32_t(VA[t].Data()[i * TILE_COLSB + k]) *
+                                            VB[t].Data()[k / 4 * TILE_COLSB + j * 4 + k % 4];
+                }
+            }
+        }
+    }
+    return c;
+}
+
+static bool TutorialMatches(const TutorialData &d, bool two_by_two, int tiles) {
+    auto same = [](const Matrix<int32_t> &c, const std::vector<int32_t> &want) {
+        return std::equal(want.begin(), want.end(), c.Data());
+    };
+    if (!same(d.C00, TutorialReference(d.VA0, d.VB0, tiles))) return false;
+    if (!two_by_two) return true;
+    return same(d.C01, TutorialReference(d.VA0, d.VB1, tiles)) &&
+           same(d.C10, TutorialReference(d.VA1, d.VB0, tiles)) &&
+           same(d.C11, TutorialReference(d.VA1, d.VB1, tiles));
+}
+
+// 第1~5版内核: 随机的 K tile 个数, C 从 0 开始调用一次; v5 在线程池的每个线程上各算一份
+static void VerifyTutorial(GemmVerifier &verifier, WorkerPool *pool, int cases) {
+    verifier.BeginSection("amx 第1~5版内核");
+    for (const char *v : {"v1", "v2", "v3", "v4", "v5"}) {
+        const std::string name = v;
+        const bool two_by_two = name == "v2" || name == "v4" || name == "v5";
+        const bool k_loop = name == "v3" || name == "v4" || name == "v5";
+        for (int c = 0; c < cases; ++c) {
+            const bool vnni = (name == "v4" || name == "v5") && c % 2 == 1;
+            const int tiles = k_loop ? 1 + verifier.Rng()() % 24 : 1;
+            const int threads = name == "v5" && pool ? pool->Size() : 1;
+            std::vector<TutorialData> data;
+            data.reserve(threads);
+            for (int t = 0; t < threads; ++t) data.emplace_back(tiles, verifier.Rng());
+            const auto kernel = TutorialKernel(name, vnni);
+            auto body = [&](int t, int) {
+                LoadTutorialConfig();
+                kernel(data[t]);
+            };
+            if (threads > 1) {
+                pool->Run(threads, body);
+            } else {
+                body(0, 0);
+            }
+            for (int t = 0; t < threads; ++t) {
+                verifier.Record(TutorialMatches(data[t], two_by_two, tiles),
+                                name + " K=" + std::to_string(tiles * TILE_COLSB) +
+                                    (vnni ? ", vnni 布局" : "") + ", 线程 " + std::to_string(t),
+                                "C tile 与参考结果不一致");
+            }
+        }
+    }
+    verifier.EndSection();
+}
+
+static int RunVerify(const BenchOptions &opt) {
+    std::unique_ptr<WorkerPool> pool;
+    const int threads = opt.threads >= 0 ? opt.threads : 4;
+    if (threads != 1) pool = std::make_unique<WorkerPool>(threads);
+
+    std::cout << "随机种子: " << opt.seed << ", 每组问题个数: " << opt.cases
+              << ", 线程池: " << (pool ? pool->Size() : 0) << "\n";
+    GemmVerifier verifier(opt.seed, opt.cases, pool.get(), std::cout);
+    verifier.VerifyAll();
+    if (GetCpuFeatures().amx_int8 && RequestAmxPermission()) {
+        VerifyTutorial(verifier, pool.get(), opt.cases);
+    }
+    std::cout << "共 " << verifier.Checks() << " 项, 失败 " << verifier.Failures() << " 项\n";
+    return verifier.Failures() == 0 ? 0 : 1;
+}
+
+// ---------------- 输出 ----------------
+
+// 计数器的每次调用值和每 GOP 值, 不可用时返回 false
+static bool CounterRates(const BenchCase &bc, const BenchResult &r, const PerfReading &c,
+                         double &per_call, double &per_gop) {
+    if (!c.available) return false;
+    per_call = c.value / r.counted_calls;
+    per_gop = per_call / (bc.ops / 1e9);
+    return true;
+}
+
+// --roofline 的各项数值, JSON 和 CSV 共用; text 为 true 的值在 JSON 中加引号
+struct ReportField {
+    const char *name;
+    std::string value;
+    bool text;
+};
+
+static std::vector<ReportField> RooflineFields(const BenchCase &bc, const BenchResult &r) {
+    auto number = [](double value) {
+        std::ostringstream out;
+        out << std::setprecision(6) << value;
+        return out.str();
+    };
+    const RooflineCeilings &c = r.ceilings;
+    const RooflinePoint &p = r.roofline;
+    auto integer = [](int64_t value) { return std::to_string(value); };
+    return {{"tile_loads", integer(bc.traffic.loads), false},
+            {"tile_stores", integer(bc.traffic.stores), false},
+            {"tile_dots", integer(bc.traffic.dots), false},
+            {"tile_bytes", integer(bc.traffic.Bytes()), false},
+            {"min_bytes", integer(bc.min_bytes), false},
+            {"tile_intensity", number(p.tile_intensity), false},
+            {"memory_intensity", number(p.memory_intensity), false},
+            {"int8_peak_gops", number(c.int8_gops), false},
+            {"bf16_peak_gflops", number(c.bf16_gflops), false},
+            {"l1_tile_gbps", number(c.l1_tile_gbps), false},
+            {"l2_tile_gbps", number(c.l2_tile_gbps), false},
+            {"memory_gbps", number(c.memory_gbps), false},
+            {"tmul_roof_gops", number(p.tmul_gops), false},
+            {"tile_roof_gops", number(p.tile_gops), false},
+            {"tile_level", p.tile_level, true},
+            {"memory_roof_gops", number(p.memory_gops), false},
+            {"roof_gops", number(p.roof_gops), false},
+            {"bound", p.bound, true},
+            {"roof_fraction", number(p.fraction), false}};
+}
+
+static void PrintRoofline(const BenchCase &bc, const BenchResult &r) {
+    const RooflineCeilings &c = r.ceilings;
+    const RooflinePoint &p = r.roofline;
+    auto roof = [](double gops) {
+        std::ostringstream out;
+        if (gops > 0) {
+            out << std::fixed << std::setprecision(1) << gops;
+        } else {
+            out << "不适用";
+        }
+        return out.str();
+    };
+    std::cout << std::fixed << std::setprecision(1) << "屋顶线 (微基准, 线程数 " << c.threads
+              << "):\n";
+    std::cout << "  TMUL 峰值: int8 " << c.int8_gops << " GOPS, bf16 " << c.bf16_gflops
+              << " GFLOPS\n";
+    std::cout << "  tile 加载带宽: L1 " << c.l1_tile_gbps << " GB/s, L2 " << c.l2_tile_gbps
+              << " GB/s; 内存读带宽: " << c.memory_gbps << " GB/s\n";
+    std::cout << std::setprecision(2);
+    if (bc.traffic.dots > 0) {
+        std::cout << "  tile 指令 (每次调用): 加载 " << bc.traffic.loads << ", 存回 "
+                  << bc.traffic.stores << ", 乘加 " << bc.traffic.dots << ", 读写 "
+                  << bc.traffic.Bytes() << " 字节, 强度 " << p.tile_intensity << " ops/B\n";
+    }
+    std::cout << "  最少读写 (每次调用): " << bc.min_bytes << " 字节, 强度 " << p.memory_intensity
+              << " ops/B\n";
+    std::cout << "  上限 (GOPS): TMUL " << roof(p.tmul_gops) << ", tile";
+    if (p.tile_gops > 0) std::cout << " (" << p.tile_level << ")";
+    std::cout << " " << roof(p.tile_gops) << ", 内存 " << roof(p.memory_gops) << "\n";
+    if (p.roof_gops > 0) {
+        std::cout << std::setprecision(1) << "  受限于 " << p.bound << ", 实测中位数为上限的 "
+                  << p.fraction * 100 << "%\n";
+    }
+}
+
+static void PrintResult(const BenchOptions &opt, const BenchCase &bc, const BenchResult &r) {
+    std::ostringstream shape;
+    shape << bc.m << "x" << bc.n << "x" << bc.k;
+    const int batch = opt.variant == "batched" ? opt.batch : 1;
+    // 每次调用请求 tile 配置、执行 ldtilecfg 和新构造配置的次数 (所有线程之和)
+    const double timed_calls = double(r.calls) * opt.reps;
+    const double config_requests = r.tile_config.requests / timed_calls;
+    const double config_loads = r.tile_config.loads / timed_calls;
+    const double config_builds = r.tile_config.builds / timed_calls;
+
+    if (opt.format == "json") {
+        std::cout << std::setprecision(6) << "{\"variant\": \"" << opt.variant
+                  << "\", \"backend\": \"" << bc.backend << "\", \"shape\": \"" << shape.str()
+                  << "\", \"m\": " << bc.m << ", \"n\": " << bc.n << ", \"k\": " << bc.k
+                  << ", \"batch\": " << batch << ", \"kernel\": \"" << bc.kernel
+                  << "\", \"layout\": \"" << bc.layout << "\", \"threads\": " << bc.threads
+                  << ", \"split_k\": " << bc.split_k
+                  << ", \"warmup\": " << opt.warmup << ", \"reps\": " << opt.reps
+                  << ", \"calls\": " << r.calls << ", \"min_us\": " << r.min_us
+                  << ", \"median_us\": " << r.median_us << ", \"p99_us\": " << r.p99_us
+                  << ", \"gops\": " << r.gops << ", \"peak_gops\": " << r.peak_gops
+                  << ", \"tilecfg_requests\": " << config_requests
+                  << ", \"tilecfg_loads\": " << config_loads
+                  << ", \"tilecfg_builds\": " << config_builds;
+        if (!r.counters.empty()) {
+            std::cout << ", \"counters\": {";
+            for (size_t i = 0; i < r.counters.size(); ++i) {
+                double per_call, per_gop;
+                std::cout << (i ? ", " : "") << "\"" << r.counters[i].name << "\": ";
+                if (CounterRates(bc, r, r.counters[i], per_call, per_gop)) {
+                    std::cout << "{\"per_call\": " << per_call << ", \"per_gop\": " << per_gop
+                              << "}";
+                } else {
+                    std::cout << "null";
+                }
+            }
+            std::cout << "}";
+        }
+        if (opt.roofline) {
+            std::cout << ", \"roofline\": {";
+            bool first = true;
+            for (const ReportField &f : RooflineFields(bc, r)) {
+                std::cout << (first ? "" : ", ") << "\"" << f.name << "\": ";
+                std::cout << (f.text ? "\"" + f.value + "\"" : f.value);
+                first = false;
+            }
+            std::cout << "}";
+        }
+        std::cout << "}\n";
+    } else if (opt.format == "csv") {
+        if (opt.header) {
+            std::cout << "variant,backend,m,n,k,batch,kernel,layout,threads,split_k,warmup,reps,"
+                         "calls,min_us,median_us,p99_us,gops,peak_gops,tilecfg_requests,"
+                         "tilecfg_loads,tilecfg_builds";
+            for (const PerfReading &c : r.counters) {
+                std::cout << "," << c.name << "_per_call," << c.name << "_per_gop";
+            }
+            if (opt.roofline) {
+                for (const ReportField &f : RooflineFields(bc, r)) std::cout << "," << f.name;
+            }
+            std::cout << "\n";
+        }
+        std::cout << std::setprecision(6) << opt.variant << "," << bc.backend << "," << bc.m
+                  << "," << bc.n << "," << bc.k << "," << batch << "," << bc.kernel << ","
+                  << bc.layout << "," << bc.threads << "," << bc.split_k << "," << opt.warmup
+                  << "," << opt.reps << "," << r.calls << "," << r.min_us << "," << r.median_us
+                  << "," << r.p99_us << "," << r.gops << "," << r.peak_gops << ","
+                  << config_requests << "," << config_loads << "," << config_builds;
+        for (const PerfReading &c : r.counters) {
+            double per_call, per_gop;
+            if (CounterRates(bc, r, c, per_call, per_gop)) {
+                std::cout << "," << per_call << "," << per_gop;
+            } else {
+                std::cout << ",,";  // 不可用的计数器留空
+            }
+        }
+        if (opt.roofline) {
+            for (const ReportField &f : RooflineFields(bc, r)) std::cout << "," << f.value;
+        }
+        std::cout << "\n";
+    } else {
+        std::cout << "变体: " << opt.variant << ", 后端: " << bc.backend << ", 形状: "
+                  << shape.str();
+        if (batch > 1) std::cout << " x " << batch;
+        std::cout << ", 分块: " << bc.kernel << ", 布局: " << bc.layout
+                  << ", 线程数: " << bc.threads;
+        if (bc.split_k > 1) std::cout << ", K 切分: " << bc.split_k;
+        std::cout << "\n";
+        std::cout << "预热: " << opt.warmup << ", 样本数: " << opt.reps
+                  << ", 每个样本调用次数: " << r.calls << "\n";
+        std::cout << std::fixed << std::setprecision(3) << "每次调用耗时(us): 最小 " << r.min_us
+                  << ", 中位数 " << r.median_us << ", p99 " << r.p99_us << "\n";
+        std::cout << std::setprecision(4) << "GOPS: 中位数 " << r.gops << ", 最高 "
+                  << r.peak_gops << "\n";
+        if (r.tile_config.requests > 0) {
+            std::cout << std::setprecision(2) << "tile 配置 (每次调用): 请求 " << config_requests
+                      << ", ldtilecfg " << config_loads << ", 新构造 " << config_builds << "\n";
+        }
+        if (!r.counters.empty()) {
+            std::cout << "硬件计数器 (所有线程之和, 每次调用 / 每 GOP):\n" << std::setprecision(2);
+            double cycles = 0, instructions = 0;
+            for (const PerfReading &c : r.counters) {
+                double per_call, per_gop;
+                std::cout << "  " << std::left << std::setw(16) << c.name << std::right;
+                if (CounterRates(bc, r, c, per_call, per_gop)) {
+                    std::cout << per_call << " / " << per_gop << "\n";
+                } else {
+                    std::cout << "不可用\n";
+                }
+                if (std::strcmp(c.name, "cycles") == 0 && c.available) cycles = c.value;
+                if (std::strcmp(c.name, "instructions") == 0 && c.available) {
+                    instructions = c.value;
+                }
+            }
+            if (cycles > 0 && instructions > 0) {
+                std::cout << "  IPC " << instructions / cycles << "\n";
+            }
+        }
+        if (bc.summary) std::cout << bc.summary() << "\n";
+        if (opt.roofline) PrintRoofline(bc, r);
+    }
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opt;
+    if (!ParseArgs(argc, argv, opt)) {
+        std::cerr << USAGE;
+        return 2;
+    }
+    if (opt.format != "text" && opt.format != "json" && opt.format != "csv") {
+        std::cerr << "未知的输出格式: " << opt.format << "\n" << USAGE;
+        return 2;
+    }
+
+    try {
+        if (opt.verify) return RunVerify(opt);
+        if (opt.sweep_m.empty()) opt.sweep_m.push_back(opt.m);
+        if (opt.m == 0 && opt.sweep_m[0] > 0) opt.n = opt.k = 4096;
+        for (int m : opt.sweep_m) {
+            opt.m = m;
+            std::unique_ptr<WorkerPool> pool;
+            const BenchCase bc = MakeCase(opt, pool);
+            BenchResult r = Measure(bc, opt);
+            if (opt.roofline) {
+                r.ceilings = MeasureRooflineCeilings(pool.get());
+                r.roofline = LocateOnRoofline(double(bc.ops), bc.traffic, bc.min_bytes, bc.bf16,
+                                              r.ceilings, r.gops);
+            }
+            PrintResult(opt, bc, r);
+            opt.header = false;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+inline uint16_t FloatToBf16Bits(float x) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    // NaN 不做舍入 (尾数只在低 16 位时会舍入成 Inf, 全 1 时进位到符号位), 截断后置静默位
+    if ((bits & 0x7FFFFFFF) > 0x7F800000) return static_cast<uint16_t>((bits >> 16) | 0x40);
+    bits += 0x7FFF + ((bits >> 16) & 1);  // 就近舍入到偶数
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+inline float Bf16BitsToFloat(uint16_t bits) {
+    const uint32_t value = static_cast<uint32_t>(bits) << 16;
+    float x;
+    std::memcpy(&x, &value, sizeof(x));
+    return x;
+}
+
+// bf16: fp32 的高 16 位 (1 位符号, 8 位指数, 7 位尾数), 与 fp32 的转换只需移位和舍入
+struct bfloat16 {
+    uint16_t bits = 0;
+
+    bfloat16() = default;
+    explicit bfloat16(float x) : bits(FloatToBf16Bits(x)) {}
+
+    operator float() const { return Bf16BitsToFloat(bits); }
+};
+
+static_assert(sizeof(bfloat16) == 2, "bfloat16 must be 2 bytes");
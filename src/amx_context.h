@@ -0,0 +1,171 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "amx_cpu.h"
+
+struct __tile_config {
+    uint8_t palette_id;  // 配置模式:0 1
+    uint8_t start_row;
+    uint8_t reserved_0[14];
+    uint16_t colsb[16];  // 每个 tile 的列字节数
+    uint8_t rows[16];    // 每个 tile 的行数
+};
+
+// 每个线程的 tile 配置统计
+struct TileConfigStats {
+    uint64_t requests = 0;  // 请求加载配置的次数
+    uint64_t loads = 0;     // 实际执行 ldtilecfg 的次数
+    uint64_t builds = 0;    // 按签名查找时缓存未命中、重新构造配置的次数
+};
+
+// tile 配置和 tile 数据都是线程私有的状态: 每个线程在第一次使用时申请权限并加载配置,
+// 线程退出时释放。IntelAmxMatrixMultiply 对象本身不再持有 tile 状态, 可以在线程间共享。
+//
+// ldtilecfg 会清零全部 tile, 代价不小, 因此只在生效的配置真正变化时执行。调用方可以给配置
+// 一个签名 (由分块和各 tile 的形状编码而成, 相同签名的配置内容必须相同): 签名与当前配置相同时
+// 直接返回, 不必构造和比较配置; 不同时从每个线程的小缓存中取出之前构造好的配置。
+// 各线程的统计可以通过 TotalStats 汇总, 用来观察混合形状的负载多久重新配置一次
+class AmxThreadContext {
+   private:
+    static constexpr int CACHE_SLOTS = 32;  // 直接映射, 冲突时覆盖
+
+    struct CacheEntry {
+        uint64_t key = 0;
+        __tile_config config{};
+    };
+
+    // 所有线程的上下文, 以及已退出线程的统计之和
+    struct Registry {
+        std::mutex mutex;
+        std::vector<const AmxThreadContext *> contexts;
+        TileConfigStats retired;
+    };
+
+    alignas(64) __tile_config config{};
+    bool config_loaded = false;
+    uint64_t active_key = 0;  // 当前配置的签名, 0 表示没有签名
+    CacheEntry cache[CACHE_SLOTS];
+
+    // 只由本线程写入, 其它线程在 TotalStats 中读取
+    std::atomic<uint64_t> requests{0}, loads{0}, builds{0};
+
+    // 有意不析构: 注册表在第一个工作线程创建上下文时才构造, 晚于 WorkerPool::Default() 等
+    // 静态对象; 退出时这些对象析构、join 工作线程, 线程退出时的 ~AmxThreadContext 仍要使用它
+    static Registry &GetRegistry() {
+        static Registry *registry = new Registry;
+        return *registry;
+    }
+
+    static void Bump(std::atomic<uint64_t> &counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    AmxThreadContext() {
+        Registry &registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.contexts.push_back(this);
+    }
+
+    TARGET_AMX void Load(const __tile_config &tileinfo, uint64_t key) {
+        if (!config_loaded) RequestAmxPermission();
+        config = tileinfo;
+        config_loaded = true;
+        active_key = key;
+        Bump(loads);
+        // _tile_loadconfig 的内联汇编只声明读取 8 字节, 这里让整个结构体对编译器可见,
+        // 避免 rows/colsb 的初始化被当成死存储消除
+        asm volatile("" : : "r"(&config) : "memory");
+        _tile_loadconfig(&config);
+    }
+
+   public:
+    AmxThreadContext(const AmxThreadContext &) = delete;
+    AmxThreadContext &operator=(const AmxThreadContext &) = delete;
+
+    TARGET_AMX ~AmxThreadContext() {
+        Release();
+        Registry &registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        const TileConfigStats stats = Stats();
+        registry.retired.requests += stats.requests;
+        registry.retired.loads += stats.loads;
+        registry.retired.builds += stats.builds;
+        auto &list = registry.contexts;
+        list.erase(std::remove(list.begin(), list.end(), this), list.end());
+    }
+
+    static AmxThreadContext &Current() {
+        static thread_local AmxThreadContext context;
+        return context;
+    }
+
+    // 只有配置真正变化时才执行 ldtilecfg
+    TARGET_AMX void LoadTileConfig(const __tile_config &tileinfo) {
+        Bump(requests);
+        if (config_loaded && std::memcmp(&tileinfo, &config, sizeof(config)) == 0) {
+            return;
+        }
+        Load(tileinfo, 0);
+    }
+
+    // 按签名加载配置, key 不能为 0; 缓存中没有时调用 build(__tile_config &) 构造
+    // (传入的配置已清零)
+    template <typename Build>
+    TARGET_AMX void LoadTileConfig(uint64_t key, Build &&build) {
+        Bump(requests);
+        if (config_loaded && key == active_key) return;
+        CacheEntry &entry = cache[(key * 0x9E3779B97F4A7C15ull) >> 59];
+        if (entry.key != key) {
+            entry.config = __tile_config{};
+            build(entry.config);
+            entry.key = key;
+            Bump(builds);
+        }
+        // 不同签名也可能对应相同的内容 (例如只差在不使用的 tile 上)
+        if (config_loaded && std::memcmp(&entry.config, &config, sizeof(config)) == 0) {
+            active_key = key;
+            return;
+        }
+        Load(entry.config, key);
+    }
+
+    // 释放当前线程的 tile 状态, 之后的第一次调用会重新加载配置
+    TARGET_AMX void Release() {
+        if (!config_loaded) return;
+        _tile_release();
+        config_loaded = false;
+        active_key = 0;
+    }
+
+    bool ConfigLoaded() const { return config_loaded; }
+
+    TileConfigStats Stats() const {
+        TileConfigStats stats;
+        stats.requests = requests.load(std::memory_order_relaxed);
+        stats.loads = loads.load(std::memory_order_relaxed);
+        stats.builds = builds.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    // 所有线程 (包括已退出的线程) 的统计之和
+    static TileConfigStats TotalStats() {
+        Registry &registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        TileConfigStats total = registry.retired;
+        for (const AmxThreadContext *context : registry.contexts) {
+            const TileConfigStats stats = context->Stats();
+            total.requests += stats.requests;
+            total.loads += stats.loads;
+            total.builds += stats.builds;
+        }
+        return total;
+    }
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cpuid.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+
+// 各后端内核使用函数级的 target 属性编译, 不依赖全局的 -march/-mamx-* 选项,
+// 同一个二进制可以在没有 AMX 的机器上运行。支持 AMX 的 CPU 都支持 prefetchw
+#define TARGET_AMX __attribute__((target("amx-tile,amx-int8,amx-bf16,prfchw")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#define TARGET_AVX512_VNNI __attribute__((target("avx512f,avx512bw,avx512vnni")))
+#define TARGET_AVX512_BF16 __attribute__((target("avx512f,avx512bw,avx512bf16")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+struct CpuFeatures {
+    bool avx2 = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+    bool avx512vnni = false;
+    bool avx512bf16 = false;
+    bool amx_tile = false;
+    bool amx_int8 = false;
+    bool amx_bf16 = false;
+};
+
+// 通过 CPUID 检测指令集, 并用 XGETBV 确认操作系统已开启对应的寄存器状态
+inline CpuFeatures DetectCpuFeatures() {
+    CpuFeatures f;
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return f;
+    const bool osxsave = ecx & (1u << 27);
+    if (!osxsave) return f;
+
+    uint32_t xcr0_lo, xcr0_hi;
+    asm volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    const uint64_t xcr0 = (static_cast<uint64_t>(xcr0_hi) << 32) | xcr0_lo;
+    const bool os_avx = (xcr0 & 0x6) == 0x6;          // XMM | YMM
+    const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;     // + opmask | ZMM_Hi256 | Hi16_ZMM
+    const bool os_amx = (xcr0 & 0x60000) == 0x60000;  // XTILECFG | XTILEDATA
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return f;
+    f.avx2 = os_avx && (ebx & (1u << 5));
+    f.avx512f = os_avx512 && (ebx & (1u << 16));
+    f.avx512bw = f.avx512f && (ebx & (1u << 30));
+    f.avx512vnni = f.avx512bw && (ecx & (1u << 11));
+    f.amx_bf16 = os_amx && (edx & (1u << 22));
+    f.amx_tile = os_amx && (edx & (1u << 24));
+    f.amx_int8 = os_amx && (edx & (1u << 25));
+
+    if (__get_cpuid_count(7, 1, &eax, &ebx, &ecx, &edx)) {
+        f.avx512bf16 = f.avx512bw && (eax & (1u << 5));
+    }
+    return f;
+}
+
+inline const CpuFeatures &GetCpuFeatures() {
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
+
+// 向内核申请 XTILEDATA 的使用权限 (进程级), 失败时返回 false 而不是直接退出
+inline bool RequestAmxPermission() {
+    static const bool granted = [] {
+        const int ARCH_REQ_XCOMP_PERM = 0x1023;
+        const int XFEATURE_XTILEDATA = 18;
+        return syscall(SYS_arch_prctl, ARCH_REQ_XCOMP_PERM, XFEATURE_XTILEDATA) == 0;
+    }();
+    return granted;
+}
+
+enum class GemmBackend { SCALAR, AVX2, AVX512_VNNI, AVX512_BF16, AMX };
+
+inline const char *GemmBackendName(GemmBackend backend) {
+    switch (backend) {
+        case GemmBackend::AMX:
+            return "amx";
+        case GemmBackend::AVX512_BF16:
+            return "avx512_bf16";
+        case GemmBackend::AVX512_VNNI:
+            return "avx512_vnni";
+        case GemmBackend::AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+// 环境变量 AMX_GEMM_BACKEND 可以强制使用比 best 更低的后端, 便于在 AMX 机器上验证其它路径;
+// 指定的后端不适用于当前数据类型 (不在 available 中) 时忽略
+inline GemmBackend OverrideGemmBackend(GemmBackend best,
+                                       std::initializer_list<GemmBackend> available) {
+    const char *env = std::getenv("AMX_GEMM_BACKEND");
+    if (env == nullptr) return best;
+    for (auto b : available) {
+        if (std::strcmp(env, GemmBackendName(b)) == 0 && b < best) return b;
+    }
+    return best;
+}
+
+// 选择当前机器上最快的 int8 后端 (amx/avx512_vnni/avx2/scalar)
+inline GemmBackend SelectGemmBackend() {
+    const CpuFeatures &f = GetCpuFeatures();
+    GemmBackend best = GemmBackend::SCALAR;
+    if (f.amx_tile && f.amx_int8 && RequestAmxPermission()) {
+        best = GemmBackend::AMX;
+    } else if (f.avx512vnni) {
+        best = GemmBackend::AVX512_VNNI;
+    } else if (f.avx2) {
+        best = GemmBackend::AVX2;
+    }
+    return OverrideGemmBackend(best, {GemmBackend::SCALAR, GemmBackend::AVX2,
+                                      GemmBackend::AVX512_VNNI, GemmBackend::AMX});
+}
+
+// 选择当前机器上最快的 bf16 后端 (amx/avx512_bf16/scalar)
+inline GemmBackend SelectGemmBackendBf16() {
+    const CpuFeatures &f = GetCpuFeatures();
+    GemmBackend best = GemmBackend::SCALAR;
+    if (f.amx_tile && f.amx_bf16 && RequestAmxPermission()) {
+        best = GemmBackend::AMX;
+    } else if (f.avx512bf16) {
+        best = GemmBackend::AVX512_BF16;
+    }
+    return OverrideGemmBackend(best,
+                               {GemmBackend::SCALAR, GemmBackend::AVX512_BF16, GemmBackend::AMX});
+}
+
+// 缓存层次信息, 用于确定 GEMM 的分块大小
+struct CacheInfo {
+    size_t l1d = 48 << 10;
+    size_t l2 = 2 << 20;
+    size_t llc = 32 << 20;
+    int llc_shared_cpus = 1;  // 共享 LLC 的逻辑 CPU 数
+};
+
+// "48K" / "2048K" / "105M" -> 字节数
+inline size_t ParseCacheSize(const std::string &text) {
+    size_t value = std::strtoull(text.c_str(), nullptr, 10);
+    if (text.find('K') != std::string::npos) value <<= 10;
+    if (text.find('M') != std::string::npos) value <<= 20;
+    return value;
+}
+
+// "0-55,112-167" -> 112
+inline int CountCpuList(const std::string &text) {
+    int count = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string range = text.substr(pos, end - pos);
+        size_t dash = range.find('-');
+        if (dash == std::string::npos) {
+            count += 1;
+        } else {
+            count += std::atoi(range.c_str() + dash + 1) - std::atoi(range.c_str()) + 1;
+        }
+        pos = end + 1;
+    }
+    return count;
+}
+
+// 读取 /sys/devices/system/cpu/cpu0/cache, 不可用时退回 sysconf, 再不行使用默认值
+inline CacheInfo DetectCacheInfo() {
+    CacheInfo info;
+    int llc_level = 0;
+    bool found = false;
+    for (int index = 0; index < 16; ++index) {
+        const std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index);
+        std::ifstream level_file(dir + "/level"), type_file(dir + "/type");
+        std::ifstream size_file(dir + "/size"), shared_file(dir + "/shared_cpu_list");
+        int level = 0;
+        std::string type, size, shared;
+        if (!(level_file >> level) || !(type_file >> type) || !(size_file >> size)) continue;
+        if (type == "Instruction") continue;
+        found = true;
+        if (level == 1) info.l1d = ParseCacheSize(size);
+        if (level == 2) info.l2 = ParseCacheSize(size);
+        if (level >= llc_level) {
+            llc_level = level;
+            info.llc = ParseCacheSize(size);
+            info.llc_shared_cpus = shared_file >> shared ? std::max(1, CountCpuList(shared)) : 1;
+        }
+    }
+    if (!found) {
+        long l1d = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+        long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (l1d > 0) info.l1d = l1d;
+        if (l2 > 0) info.l2 = l2;
+        if (l3 > 0) info.llc = l3;
+    }
+    return info;
+}
+
+inline const CacheInfo &GetCacheInfo() {
+    static const CacheInfo info = DetectCacheInfo();
+    return info;
+}
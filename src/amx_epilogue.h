@@ -0,0 +1,318 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "amx_bfloat16.h"
+#include "amx_cpu.h"
+
+enum class EpilogueActivation { NONE, RELU, GELU, CLAMP };
+
+enum class EpilogueOutput { FP32, BF16, INT8, UINT8, INT32 };
+
+// 在累加结果 (int32, bf16 GEMM 为 fp32) 上融合的后处理, 按输出列 j:
+//   先做零点补偿 acc' = acc - za * colsum_j - zb * rowsum_i + K * za * zb (仅 int32 累加),
+//   y = row_scale_i * scale_j * acc' + bias_j, 再做激活;
+//   输出为 int8/uint8 时 out = saturate(round(y) + zero_point), 为 fp32/bf16 时 out = y;
+//   输出为 int32 时直接写出 acc', 忽略缩放、偏置和激活, dst 可以就是 C 本身
+// AMX 后端在每个 32x32 块存回后立即处理 (此时 C 仍在 L1 中), 不需要对 C 再做一遍完整的遍历
+struct GemmEpilogue {
+    const float *bias = nullptr;    // 长度 N, 为空时不加偏置
+    const float *scales = nullptr;  // 长度 N, 每输出通道的缩放; 为空时使用 scale
+    float scale = 1.0f;             // 每张量的缩放
+    // 长度 M, 每行的缩放 (动态量化时 A 每行的量化步长), 与 scales/scale 相乘; 为空时为 1
+    const float *row_scales = nullptr;
+    int32_t zero_point = 0;
+    EpilogueActivation activation = EpilogueActivation::NONE;
+    float clamp_min = 0.0f;
+    float clamp_max = 6.0f;
+    EpilogueOutput output = EpilogueOutput::FP32;
+    void *dst = nullptr;  // 输出矩阵, 行跨度 ldd (元素个数); bf16 以 uint16_t 存储
+    int ldd = 0;
+
+    // 非对称量化的零点补偿: A 的零点 za 需要 B 的列和 (长度 N, PackedB 打包时计算),
+    // B 的零点 zb 需要 A 的行和 (长度 M, 见 RowSums); k 为累加的长度, 由 Gemm 填写
+    const int32_t *col_sums = nullptr;
+    int32_t a_zero_point = 0;
+    const int32_t *row_sums = nullptr;
+    int32_t b_zero_point = 0;
+    int k = 0;
+
+    size_t ElementSize() const {
+        switch (output) {
+            case EpilogueOutput::INT8:
+            case EpilogueOutput::UINT8:
+                return 1;
+            case EpilogueOutput::BF16:
+                return 2;
+            default:
+                return 4;
+        }
+    }
+
+    // 整数输出在转换之前 y 须先限制到的范围: int8/uint8 为类型的范围减去零点, int32 为
+    // [INT32_MIN, 2147483520] (小于 2^31 的最大 float)。超出 int32 的 y 和 NaN 直接转换时
+    // 结果未定义 (AVX-512 得到 INT32_MIN), 大的正数会变成最小值
+    void OutputRange(float &lo, float &hi) const {
+        switch (output) {
+            case EpilogueOutput::INT8:
+                lo = -128.0f - zero_point, hi = 127.0f - zero_point;
+                return;
+            case EpilogueOutput::UINT8:
+                lo = 0.0f - zero_point, hi = 255.0f - zero_point;
+                return;
+            default:
+                lo = static_cast<float>(INT32_MIN), hi = 2147483520.0f;
+                return;
+        }
+    }
+
+    // 以 (i, j) 为原点的子块, 供分块或多线程时只处理 C 的一部分
+    GemmEpilogue Offset(int i, int j) const {
+        GemmEpilogue sub = *this;
+        if (bias != nullptr) sub.bias += j;
+        if (scales != nullptr) sub.scales += j;
+        if (col_sums != nullptr) sub.col_sums += j;
+        if (row_sums != nullptr) sub.row_sums += i;
+        if (row_scales != nullptr) sub.row_scales += i;
+        sub.dst = static_cast<char *>(dst) + (static_cast<size_t>(i) * ldd + j) * ElementSize();
+        return sub;
+    }
+};
+
+// GELU 的 tanh 近似 0.5x(1 + tanh(u)), u = sqrt(2/pi)(x + 0.044715x^3); 改写为等价的
+// x / (1 + exp(-2u)), 避免 x 为负时 1 + tanh(u) 的相消误差
+inline float GeluScalar(float x) {
+    const float u = 0.7978845608f * (x + 0.044715f * x * x * x);
+    return x / (1.0f + std::exp(-2.0f * u));
+}
+
+// 零点补偿中只与行有关的部分 -zb * rowsum_i + K * za * zb 和只与列有关的部分 -za * colsum_j,
+// 按 int32 回绕运算, 与累加器的溢出行为一致
+inline int32_t RowCompensation(const GemmEpilogue &ep, int i) {
+    if (ep.b_zero_point == 0 || ep.row_sums == nullptr) return 0;
+    uint32_t c =
+        0u - static_cast<uint32_t>(ep.b_zero_point) * static_cast<uint32_t>(ep.row_sums[i]);
+    if (ep.a_zero_point != 0 && ep.col_sums != nullptr) {
+        c += static_cast<uint32_t>(ep.k) * static_cast<uint32_t>(ep.a_zero_point) *
+             static_cast<uint32_t>(ep.b_zero_point);
+    }
+    return static_cast<int32_t>(c);
+}
+
+inline int32_t ColumnCompensation(const GemmEpilogue &ep, int j) {
+    if (ep.a_zero_point == 0 || ep.col_sums == nullptr) return 0;
+    return static_cast<int32_t>(0u - static_cast<uint32_t>(ep.a_zero_point) *
+                                         static_cast<uint32_t>(ep.col_sums[j]));
+}
+
+// 限制到 [lo, hi], NaN 取 lo (与 _mm512_max_ps(y, lo) 相同)
+inline float ClampToRange(float y, float lo, float hi) { return std::min(std::max(lo, y), hi); }
+
+template <typename AccType>
+inline void ApplyEpilogueScalar(int M, int N, const AccType *C, int ldc, const GemmEpilogue &ep) {
+    const size_t row_bytes = static_cast<size_t>(ep.ldd) * ep.ElementSize();
+    float out_lo, out_hi;
+    ep.OutputRange(out_lo, out_hi);
+    for (int i = 0; i < M; ++i) {
+        char *row = static_cast<char *>(ep.dst) + i * row_bytes;
+        const uint32_t row_term = static_cast<uint32_t>(RowCompensation(ep, i));
+        const float row_scale = ep.row_scales != nullptr ? ep.row_scales[i] : 1.0f;
+        for (int j = 0; j < N; ++j) {
+            AccType acc = C[static_cast<size_t>(i) * ldc + j];
+            if constexpr (!std::is_same_v<AccType, float>) {
+                acc = static_cast<AccType>(static_cast<uint32_t>(acc) + row_term +
+                                           static_cast<uint32_t>(ColumnCompensation(ep, j)));
+                if (ep.output == EpilogueOutput::INT32) {
+                    reinterpret_cast<int32_t *>(row)[j] = acc;
+                    continue;
+                }
+            }
+            float y = static_cast<float>(acc) *
+                      (row_scale * (ep.scales != nullptr ? ep.scales[j] : ep.scale));
+            if (ep.bias != nullptr) y += ep.bias[j];
+            switch (ep.activation) {
+                case EpilogueActivation::RELU:
+                    y = std::max(y, 0.0f);
+                    break;
+                case EpilogueActivation::GELU:
+                    y = GeluScalar(y);
+                    break;
+                case EpilogueActivation::CLAMP:
+                    y = std::min(std::max(y, ep.clamp_min), ep.clamp_max);
+                    break;
+                default:
+                    break;
+            }
+            switch (ep.output) {
+                case EpilogueOutput::FP32:
+                    reinterpret_cast<float *>(row)[j] = y;
+                    break;
+                case EpilogueOutput::BF16:
+                    reinterpret_cast<uint16_t *>(row)[j] = FloatToBf16Bits(y);
+                    break;
+                case EpilogueOutput::INT8: {
+                    const float v = ClampToRange(y, out_lo, out_hi);
+                    int32_t q = static_cast<int32_t>(std::nearbyint(v)) + ep.zero_point;
+                    reinterpret_cast<int8_t *>(row)[j] =
+                        static_cast<int8_t>(std::clamp(q, -128, 127));
+                    break;
+                }
+                case EpilogueOutput::UINT8: {
+                    const float v = ClampToRange(y, out_lo, out_hi);
+                    int32_t q = static_cast<int32_t>(std::nearbyint(v)) + ep.zero_point;
+                    reinterpret_cast<uint8_t *>(row)[j] =
+                        static_cast<uint8_t>(std::clamp(q, 0, 255));
+                    break;
+                }
+                case EpilogueOutput::INT32:
+                    reinterpret_cast<int32_t *>(row)[j] =
+                        static_cast<int32_t>(std::nearbyint(ClampToRange(y, out_lo, out_hi)));
+                    break;
+            }
+        }
+    }
+}
+
+// exp(x) = 2^n * exp(r), r = x - n * ln2 落在 [-ln2/2, ln2/2], exp(r) 用 6 阶多项式近似;
+// 与 std::exp 一样, 上溢时返回 inf
+TARGET_AVX512 inline __m512 Exp512(__m512 x) {
+    x = _mm512_max_ps(_mm512_min_ps(x, _mm512_set1_ps(100.0f)), _mm512_set1_ps(-100.0f));
+    const __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(1.44269504f)),
+                                          _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(0.693145752f), x);
+    r = _mm512_fnmadd_ps(n, _mm512_set1_ps(1.42860677e-6f), r);
+    __m512 p = _mm512_set1_ps(1.0f / 720);
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.0f / 120));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.0f / 24));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.0f / 6));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(0.5f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.0f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.0f));
+    return _mm512_scalef_ps(p, n);
+}
+
+// 同 GeluScalar
+TARGET_AVX512 inline __m512 Gelu512(__m512 x) {
+    const __m512 x3 = _mm512_mul_ps(_mm512_mul_ps(x, x), x);
+    const __m512 u = _mm512_mul_ps(_mm512_set1_ps(-2.0f * 0.7978845608f),
+                                   _mm512_fmadd_ps(_mm512_set1_ps(0.044715f), x3, x));
+    return _mm512_div_ps(x, _mm512_add_ps(_mm512_set1_ps(1.0f), Exp512(u)));
+}
+
+// 同 ClampToRange, 再转换为 int32 (就近偶数)
+TARGET_AVX512 inline __m512i ConvertClamped(__m512 y, __m512 lo, __m512 hi) {
+    return _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(y, lo), hi));
+}
+
+// 每次处理一行中的 16 列, 列尾用掩码读写
+template <typename AccType>
+TARGET_AVX512 inline void ApplyEpilogueAvx512(int M, int N, const AccType *C, int ldc,
+                                              const GemmEpilogue &ep) {
+    const size_t row_bytes = static_cast<size_t>(ep.ldd) * ep.ElementSize();
+    const bool use_col_sums = ep.a_zero_point != 0 && ep.col_sums != nullptr;
+    const __m512i za = _mm512_set1_epi32(ep.a_zero_point);
+    float lo, hi;
+    ep.OutputRange(lo, hi);
+    const __m512 out_lo = _mm512_set1_ps(lo), out_hi = _mm512_set1_ps(hi);
+    for (int i = 0; i < M; ++i) {
+        const AccType *c = C + static_cast<size_t>(i) * ldc;
+        char *row = static_cast<char *>(ep.dst) + i * row_bytes;
+        const __m512i row_term = _mm512_set1_epi32(RowCompensation(ep, i));
+        const __m512 row_scale = _mm512_set1_ps(ep.row_scales != nullptr ? ep.row_scales[i] : 1.0f);
+        for (int j = 0; j < N; j += 16) {
+            const __mmask16 mask = static_cast<__mmask16>((1u << std::min(16, N - j)) - 1);
+            __m512 y;
+            if constexpr (std::is_same_v<AccType, float>) {
+                y = _mm512_maskz_loadu_ps(mask, c + j);
+            } else {
+                __m512i acc = _mm512_maskz_loadu_epi32(mask, c + j);
+                if (use_col_sums) {
+                    const __m512i sums = _mm512_maskz_loadu_epi32(mask, ep.col_sums + j);
+                    acc = _mm512_sub_epi32(acc, _mm512_mullo_epi32(za, sums));
+                }
+                acc = _mm512_add_epi32(acc, row_term);
+                if (ep.output == EpilogueOutput::INT32) {
+                    _mm512_mask_storeu_epi32(reinterpret_cast<int32_t *>(row) + j, mask, acc);
+                    continue;
+                }
+                y = _mm512_cvtepi32_ps(acc);
+            }
+            const __m512 scale = _mm512_mul_ps(
+                row_scale, ep.scales != nullptr ? _mm512_maskz_loadu_ps(mask, ep.scales + j)
+                                                : _mm512_set1_ps(ep.scale));
+            if (ep.bias != nullptr) {
+                y = _mm512_fmadd_ps(y, scale, _mm512_maskz_loadu_ps(mask, ep.bias + j));
+            } else {
+                y = _mm512_mul_ps(y, scale);
+            }
+            switch (ep.activation) {
+                case EpilogueActivation::RELU:
+                    y = _mm512_max_ps(y, _mm512_setzero_ps());
+                    break;
+                case EpilogueActivation::GELU:
+                    y = Gelu512(y);
+                    break;
+                case EpilogueActivation::CLAMP:
+                    y = _mm512_min_ps(_mm512_max_ps(y, _mm512_set1_ps(ep.clamp_min)),
+                                      _mm512_set1_ps(ep.clamp_max));
+                    break;
+                default:
+                    break;
+            }
+            switch (ep.output) {
+                case EpilogueOutput::FP32:
+                    _mm512_mask_storeu_ps(reinterpret_cast<float *>(row) + j, mask, y);
+                    break;
+                case EpilogueOutput::BF16: {
+                    const __m512i raw = _mm512_castps_si512(y);
+                    __m512i lsb =
+                        _mm512_and_si512(_mm512_srli_epi32(raw, 16), _mm512_set1_epi32(1));
+                    __m512i bits = _mm512_srli_epi32(
+                        _mm512_add_epi32(raw, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7FFF))),
+                        16);
+                    // NaN 不做舍入, 截断后置静默位 (同 FloatToBf16Bits)
+                    const __mmask16 nan = _mm512_cmp_ps_mask(y, y, _CMP_UNORD_Q);
+                    bits = _mm512_mask_or_epi32(bits, nan, _mm512_srli_epi32(raw, 16),
+                                                _mm512_set1_epi32(0x40));
+                    _mm512_mask_cvtepi32_storeu_epi16(reinterpret_cast<uint16_t *>(row) + j, mask,
+                                                      bits);
+                    break;
+                }
+                case EpilogueOutput::INT8: {
+                    __m512i q = _mm512_add_epi32(ConvertClamped(y, out_lo, out_hi),
+                                                 _mm512_set1_epi32(ep.zero_point));
+                    _mm512_mask_cvtsepi32_storeu_epi8(reinterpret_cast<int8_t *>(row) + j, mask, q);
+                    break;
+                }
+                case EpilogueOutput::UINT8: {
+                    __m512i q = _mm512_add_epi32(ConvertClamped(y, out_lo, out_hi),
+                                                 _mm512_set1_epi32(ep.zero_point));
+                    q = _mm512_max_epi32(q, _mm512_setzero_si512());
+                    _mm512_mask_cvtusepi32_storeu_epi8(reinterpret_cast<uint8_t *>(row) + j, mask,
+                                                       q);
+                    break;
+                }
+                case EpilogueOutput::INT32:
+                    _mm512_mask_storeu_epi32(reinterpret_cast<int32_t *>(row) + j, mask,
+                                             ConvertClamped(y, out_lo, out_hi));
+                    break;
+            }
+        }
+    }
+}
+
+template <typename AccType>
+inline void ApplyEpilogue(int M, int N, const AccType *C, int ldc, const GemmEpilogue &ep) {
+    if (GetCpuFeatures().avx512bw) {
+        ApplyEpilogueAvx512(M, N, C, ldc, ep);
+    } else {
+        ApplyEpilogueScalar(M, N, C, ldc, ep);
+    }
+}
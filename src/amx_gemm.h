@@ -0,0 +1,1106 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "amx_context.h"
+#include "amx_cpu.h"
+#include "amx_epilogue.h"
+#include "amx_matrix.h"
+#include "amx_pack.h"
+#include "amx_thread_pool.h"
+#include "amx_tile.h"
+#include "gemm_fallback.h"
+
+// 多线程 GEMM 的宏块网格: C 被划分为 m x n 个宏块
+struct GemmGrid {
+    int m;
+    int n;
+};
+
+// 根据形状和线程数选择网格 (单位为 2x2 分块对应的 32x32 块): 每个线程约分到 4 个宏块,
+// 给窃取留出负载均衡的余地; M/N 的切分比例接近 C 的长宽比, 使宏块尽量方正,
+// 每个宏块读取的 A 行块和 B 列块之和最小
+inline GemmGrid ChooseGemmGrid(int blocks_m, int blocks_n, int threads) {
+    const int64_t total = static_cast<int64_t>(blocks_m) * blocks_n;
+    const int target = static_cast<int>(std::min<int64_t>(total, threads > 1 ? threads * 4 : 1));
+    int gm = static_cast<int>(std::lround(std::sqrt(double(target) * blocks_m / blocks_n)));
+    gm = std::max(1, std::min({gm, blocks_m, target}));
+    int gn = std::max(1, std::min((target + gm - 1) / gm, blocks_n));
+    // 规整化, 去掉因向上取整产生的空宏块
+    gm = (blocks_m + (blocks_m + gm - 1) / gm - 1) / ((blocks_m + gm - 1) / gm);
+    gn = (blocks_n + (blocks_n + gn - 1) / gn - 1) / ((blocks_n + gn - 1) / gn);
+    return {gm, gn};
+}
+
+// 按 K 切分时每片 K 的最小字节数。每片多写一遍 M x N 的部分和、归约时再读一遍;
+// 片内每个 C 元素至少做 1024 次乘加, 归约的加法 (AVX-512 每周期 16 个) 约为 TMUL 时间的 1/16
+constexpr int SPLIT_K_MIN_BYTES = 1024;
+
+// AMX 后端默认改用 GEMV 内核的 M 上限。对比 amx_bench --sweep-m 的结果 (N x K 为 1024 x 512、
+// 4096 x 1024、1024 x 4096): int8 在 M <= 2 时 GEMV 的中位数和 p99 都不高于 AMX; M = 4 时
+// B 在缓存中的形状上 AMX 更快, B 从内存读取时两者持平。bf16 的乘加每条指令只覆盖 2 个 K,
+// 只有 M = 1 时 GEMV 更快
+constexpr int GEMV_MAX_M = 2;
+constexpr int GEMV_MAX_M_BF16 = 1;
+
+// dst[0, n) += src[0, n), 用于按 K 切分后部分和的归约
+template <typename T>
+TARGET_AVX512 inline void AddRowAvx512(T *dst, const T *src, int n) {
+    for (int j = 0; j < n; j += 16) {
+        const __mmask16 mask = n - j >= 16 ? 0xFFFF : (1u << (n - j)) - 1;
+        if constexpr (std::is_same_v<T, float>) {
+            const __m512 sum = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, dst + j),
+                                             _mm512_maskz_loadu_ps(mask, src + j));
+            _mm512_mask_storeu_ps(dst + j, mask, sum);
+        } else {
+            const __m512i sum = _mm512_add_epi32(_mm512_maskz_loadu_epi32(mask, dst + j),
+                                                 _mm512_maskz_loadu_epi32(mask, src + j));
+            _mm512_mask_storeu_epi32(dst + j, mask, sum);
+        }
+    }
+}
+
+template <typename T>
+inline void AddRow(T *dst, const T *src, int n) {
+    if (GetCpuFeatures().avx512f) {
+        AddRowAvx512(dst, src, n);
+    } else {
+        for (int j = 0; j < n; ++j) dst[j] += src[j];
+    }
+}
+
+// 多级分块的大小 (元素个数), 启动时根据缓存层次确定:
+//   KC: 32 列的 B 微面板 (KC x 32 字节) 放进 L1, 在整个 A 块的所有行间复用;
+//       AMX 每个 KC 块都要读写一次 C 的 4 个 tile, KC 越大这部分开销越小
+//   MC: 打包后的 A 块 (MC x KC) 占 L2 的一半
+//   NC: B 面板 (KC x NC) 占当前核心分得的 LLC 的一半
+struct GemmBlocking {
+    int mc;
+    int nc;
+    int kc;
+    int prefetch;  // 2x2 内核提前预取的 K tile 数, 0 表示不预取, -1 表示自动
+};
+
+// 预取距离为自动时: B 已打包成连续的 1KB tile 时硬件预取器足以跟上, 软件预取反而挤占
+// 加载端口 (实测 L2 内的形状下降约 15%); B 为跨步的 VNNI 格式时每个 tile 的 16 行分散在
+// 不同的页上, 提前 PREFETCH_DISTANCE 个 K tile 预取约有 15% 的提升
+constexpr int PREFETCH_AUTO = -1;
+constexpr int PREFETCH_DISTANCE = 1;
+
+inline GemmBlocking ComputeGemmBlocking(const CacheInfo &cache) {
+    auto clamp = [](size_t v, int lo, int hi, int align) {
+        return std::max(lo, std::min(hi, static_cast<int>(v) / align * align));
+    };
+    GemmBlocking blocking;
+    blocking.kc = clamp(cache.l1d / 32, 256, 2048, 64);
+    blocking.mc = clamp(cache.l2 / 2 / blocking.kc, 32, 4096, 32);
+    const size_t llc_share = cache.llc / std::max(1, cache.llc_shared_cpus);
+    blocking.nc = clamp(llc_share / 2 / blocking.kc, 32, 1 << 16, 32);
+    blocking.prefetch = PREFETCH_AUTO;
+    return blocking;
+}
+
+// 环境变量 AMX_GEMM_BLOCKING=mc,nc,kc 可以覆盖自动选择的分块大小,
+// AMX_GEMM_PREFETCH=d 可以覆盖预取距离, 便于调优
+inline const GemmBlocking &GetGemmBlocking() {
+    static const GemmBlocking blocking = [] {
+        GemmBlocking b = ComputeGemmBlocking(GetCacheInfo());
+        const char *env = std::getenv("AMX_GEMM_BLOCKING");
+        int mc, nc, kc;
+        if (env != nullptr && std::sscanf(env, "%d,%d,%d", &mc, &nc, &kc) == 3) {
+            b.mc = std::max(32, mc / 32 * 32);
+            b.nc = std::max(32, nc / 32 * 32);
+            b.kc = std::max(64, kc / 64 * 64);
+        }
+        env = std::getenv("AMX_GEMM_PREFETCH");
+        if (env != nullptr) b.prefetch = std::max(PREFETCH_AUTO, std::atoi(env));
+        return b;
+    }();
+    return blocking;
+}
+
+// 预取一个 tile 的各行, tile 每行 64 字节, 正好一个缓存行。HINT 为 _MM_HINT_ET0 时生成
+// prefetchw, 提前以独占状态取得 C 的缓存行
+template <int HINT>
+TARGET_AMX inline void PrefetchTile(const void *tile, size_t stride, int rows) {
+    const char *row = static_cast<const char *>(tile);
+    for (int r = 0; r < rows; ++r, row += stride) {
+        _mm_prefetch(row, static_cast<_mm_hint>(HINT));
+    }
+}
+
+// AMX 内核的寄存器分块, 单位为 tile: 每次计算 mr x nr 个 16x16 的 C tile
+struct GemmKernelShape {
+    int mr;
+    int nr;
+};
+
+constexpr GemmKernelShape GEMM_KERNELS[] = {{1, 1}, {1, 2}, {2, 1}, {2, 2}, {1, 4}, {4, 1}};
+
+// 按形状选择分块: 只有一个 M tile 的矮宽矩阵用 1x2, 只有一个 N tile 的瘦高矩阵用 2x1,
+// 固定的 2x2 在这两种情况下有一半的 tile 只能算补齐的部分; 其余用 2x2 (每次乘加平均加载
+// 1 个 tile, 1x2/2x1 为 1.5 个)。1x4/4x1 虽然平均只加载 1.25 个 tile, 但较长的一侧要轮流
+// 使用 tile, 下一次加载须等上一次乘加读完同一个 tile, 在测试机上反而比 1x2/2x1 慢, 默认不选
+inline GemmKernelShape SelectGemmKernel(int M, int N) {
+    if (M <= 16) return {1, 2};
+    if (N <= 16) return {2, 1};
+    return {2, 2};
+}
+
+// 环境变量 AMX_GEMM_KERNEL=mrxnr (如 2x2) 可以强制使用指定的分块, 便于对比; 未设置或不支持时
+// 返回 {0, 0}, 表示按形状自动选择
+inline GemmKernelShape GetForcedGemmKernel() {
+    static const GemmKernelShape forced = [] {
+        const char *env = std::getenv("AMX_GEMM_KERNEL");
+        GemmKernelShape shape{0, 0};
+        if (env != nullptr && std::sscanf(env, "%dx%d", &shape.mr, &shape.nr) == 2) {
+            for (const GemmKernelShape &k : GEMM_KERNELS) {
+                if (k.mr == shape.mr && k.nr == shape.nr) return shape;
+            }
+        }
+        return GemmKernelShape{0, 0};
+    }();
+    return forced;
+}
+
+// 以编译期常量 (std::integral_constant) 调用 f(mr, nr), shape 须为 GEMM_KERNELS 之一
+template <typename F>
+inline void DispatchGemmKernel(GemmKernelShape shape, F &&f) {
+    using std::integral_constant;
+    if (shape.mr == 1 && shape.nr == 1) {
+        f(integral_constant<int, 1>{}, integral_constant<int, 1>{});
+    } else if (shape.mr == 1 && shape.nr == 2) {
+        f(integral_constant<int, 1>{}, integral_constant<int, 2>{});
+    } else if (shape.mr == 2 && shape.nr == 1) {
+        f(integral_constant<int, 2>{}, integral_constant<int, 1>{});
+    } else if (shape.mr == 1 && shape.nr == 4) {
+        f(integral_constant<int, 1>{}, integral_constant<int, 4>{});
+    } else if (shape.mr == 4 && shape.nr == 1) {
+        f(integral_constant<int, 4>{}, integral_constant<int, 1>{});
+    } else {
+        f(integral_constant<int, 2>{}, integral_constant<int, 2>{});
+    }
+}
+
+// 操作数类型组合对应的乘加指令和后端选择, 编译期确定; 没有特化的组合不支持。
+// A 为激活, B (WeightType) 为权重: 非对称量化的 uint8 激活与 int8 权重直接使用 dpbusd,
+// 不需要先把 uint8 平移成 int8
+template <typename InputType, typename OutputType, typename WeightType = InputType>
+struct AmxTypeTraits {
+    static constexpr bool SUPPORTED = false;
+};
+
+template <typename InputType, typename WeightType, AmxDotOp Op>
+struct AmxInt8Traits {
+    static constexpr bool SUPPORTED = true;
+    static constexpr AmxDotOp DOT = Op;
+    static GemmBackend SelectBackend() { return SelectGemmBackend(); }
+};
+
+template <>
+struct AmxTypeTraits<int8_t, int32_t, int8_t> : AmxInt8Traits<int8_t, int8_t, AmxDotOp::DPBSSD> {};
+template <>
+struct AmxTypeTraits<int8_t, int32_t, uint8_t> : AmxInt8Traits<int8_t, uint8_t, AmxDotOp::DPBSUD> {
+};
+template <>
+struct AmxTypeTraits<uint8_t, int32_t, int8_t> : AmxInt8Traits<uint8_t, int8_t, AmxDotOp::DPBUSD> {
+};
+template <>
+struct AmxTypeTraits<uint8_t, int32_t, uint8_t>
+    : AmxInt8Traits<uint8_t, uint8_t, AmxDotOp::DPBUUD> {};
+
+template <>
+struct AmxTypeTraits<bfloat16, float, bfloat16> {
+    static constexpr bool SUPPORTED = true;
+    static constexpr AmxDotOp DOT = AmxDotOp::DPBF16PS;
+    static GemmBackend SelectBackend() { return SelectGemmBackendBf16(); }
+};
+
+// InputType 为 A 的元素类型, WeightType 为 B 的元素类型 (默认与 A 相同)
+template <typename InputType, typename OutputType, typename WeightType = InputType>
+class IntelAmxMatrixMultiply {
+    static_assert(AmxTypeTraits<InputType, OutputType, WeightType>::SUPPORTED,
+                  "IntelAmxMatrixMultiply supports int8/uint8 x int8/uint8 -> int32 "
+                  "and bfloat16 x bfloat16 -> float");
+
+    using Traits = AmxTypeTraits<InputType, OutputType, WeightType>;
+    static constexpr AmxDotOp DOT = Traits::DOT;
+    static constexpr int TK = TILE_K<InputType>;     // 一个 K tile 的元素个数
+    static constexpr int G = VNNI_GROUP<InputType>;  // VNNI 格式中每组的 K 元素个数
+
+   private:
+    IntelAmxMatrixMultiply() = default;
+
+    // 第4/5版接口使用的配置: 8 个 tile 都是 16 行 x COLSB 字节, 签名为 1
+    TARGET_AMX void InitTileConfig() {
+        AmxThreadContext::Current().LoadTileConfig(1, [this](__tile_config &tileinfo) {
+            tileinfo.palette_id = 1;
+            for (int i = 0; i < 8; ++i) {
+                tileinfo.colsb[i] = COLSB;
+                tileinfo.rows[i] = ROWS;
+            }
+        });
+    }
+
+    // MR x NR 分块的 tile 配置, m[i] / n[j] 为第 i 个 M tile 的行数和第 j 个 N tile 的列数;
+    // 轮流使用的 tile 按第一次使用时的形状配置, 调用方保证这一侧各 tile 的形状相同。
+    // 签名依次编码 MR、NR、A tile 的列字节数和各 tile 的行列数 (都不超过 64), 最低位为 0,
+    // 不会与 InitTileConfig 冲突
+    template <int MR, int NR>
+    TARGET_AMX void LoadKernelConfig(const int *m, const int *n, int kb) {
+        using Block = TileBlock<MR, NR>;
+        const int kp = (kb + G - 1) / G * 4;  // A tile 的列字节数
+        uint64_t key = (uint64_t(MR) << 1) | (uint64_t(NR) << 4) | (uint64_t(kp) << 7);
+        for (int i = 0; i < MR; ++i) key |= uint64_t(m[i]) << (14 + 5 * i);
+        for (int j = 0; j < NR; ++j) key |= uint64_t(n[j]) << (34 + 5 * j);
+
+        AmxThreadContext::Current().LoadTileConfig(key, [&](__tile_config &tileinfo) {
+            tileinfo.palette_id = 1;
+            for (int i = MR - 1; i >= 0; --i) {
+                tileinfo.rows[Block::A(i)] = m[i], tileinfo.colsb[Block::A(i)] = kp;
+            }
+            for (int j = NR - 1; j >= 0; --j) {
+                tileinfo.rows[Block::B(j)] = kp / 4, tileinfo.colsb[Block::B(j)] = n[j] * 4;
+            }
+            for (int i = 0; i < MR; ++i) {
+                for (int j = 0; j < NR; ++j) {
+                    tileinfo.rows[Block::C(i, j)] = m[i];
+                    tileinfo.colsb[Block::C(i, j)] = n[j] * 4;
+                }
+            }
+        });
+    }
+
+    // 第4/5版 2x2 寄存器分块内核的一般化: MR 个 A tile 与 NR 个 B tile 计算 MR x NR 个 C tile,
+    // tile 编号 (TileBlock) 和加载/乘加序列在编译期展开。A/B/C 由指针和行跨度(字节)描述;
+    // 第 i 个 A tile 为 A + i * a_tile, 第 j 个 B tile 为 B + j * b_tile,
+    // a_step/b_step 为 K 方向相邻两个 tile 的距离(元素个数)
+    template <int MR, int NR>
+    TARGET_AMX void KernelTiles(const InputType *A, size_t a_stride, size_t a_tile, size_t a_step,
+                                const WeightType *B, size_t b_stride, size_t b_tile,
+                                size_t b_step, OutputType *C, size_t c_stride, int ksteps,
+                                bool accumulate, int prefetch) {
+        using Block = TileBlock<MR, NR>;
+        const size_t c_rows = c_stride / sizeof(OutputType) * ROWS;
+        const int TN = COLSB / 4;
+
+        Unroll<MR>([&](auto i) {
+            Unroll<NR>([&](auto j) {
+                constexpr int TILE = Block::C(decltype(i)::value, decltype(j)::value);
+                OutputType *c = C + i * c_rows + j * TN;
+                if (accumulate) {
+                    TileLoad<TILE>(c, c_stride);
+                } else {
+                    TileZero<TILE>();
+                }
+            });
+        });
+
+        // 软件流水: 每个乘加所需的两个 tile 一到齐就开始计算, 其余的加载与 TMUL 重叠
+        // (2x2 时为 A0 B0 C00, B1 C01, A1 C10 C11, 与第5版相同);
+        // 同时预取 prefetch 个 K tile 之后的 A/B, 操作数不在 L1 时 TMUL 不必等待加载
+        for (int k = 0; k < ksteps; ++k) {
+            if (prefetch > 0 && k + prefetch < ksteps) {
+                const size_t ahead = k + prefetch;
+                for (int i = 0; i < MR; ++i) {
+                    PrefetchTile<_MM_HINT_T0>(A + i * a_tile + ahead * a_step, a_stride, ROWS);
+                }
+                for (int j = 0; j < NR; ++j) {
+                    PrefetchTile<_MM_HINT_T0>(B + j * b_tile + ahead * b_step, b_stride, ROWS);
+                }
+            }
+
+            Unroll<MR>([&](auto i) {
+                constexpr int I = decltype(i)::value;
+                TileLoad<Block::A(I)>(A + I * a_tile + k * a_step, a_stride);
+                Unroll<NR>([&](auto j) {
+                    constexpr int J = decltype(j)::value;
+                    // 轮流使用的 B tile 只出现在 MR == 1 时, 同样只需在第一行加载
+                    if constexpr (I == 0) {
+                        TileLoad<Block::B(J)>(B + J * b_tile + k * b_step, b_stride);
+                    }
+                    TileDot<DOT, Block::C(I, J), Block::A(I), Block::B(J)>();
+                });
+            });
+        }
+
+        Unroll<MR>([&](auto i) {
+            Unroll<NR>([&](auto j) {
+                constexpr int TILE = Block::C(decltype(i)::value, decltype(j)::value);
+                TileStore<TILE>(C + i * c_rows + j * TN, c_stride);
+            });
+        });
+    }
+
+    // 不完整的块按不超过 2x2 的子块计算, 这些分块的 tile 各自常驻, 形状可以各不相同
+    TARGET_AMX void KernelEdge(int mt, int nt, const int *m, const int *n, const InputType *A,
+                               size_t a_stride, size_t a_tile, size_t a_step, const WeightType *B,
+                               size_t b_stride, size_t b_tile, size_t b_step, OutputType *C,
+                               size_t c_stride, int kb, int ksteps, bool accumulate,
+                               int prefetch) {
+        const size_t c_rows = c_stride / sizeof(OutputType) * ROWS;
+        for (int bi = 0; bi < mt; bi += 2) {
+            for (int bj = 0; bj < nt; bj += 2) {
+                const GemmKernelShape shape{std::min(2, mt - bi), std::min(2, nt - bj)};
+                DispatchGemmKernel(shape, [&](auto mr, auto nr) {
+                    constexpr int MR = decltype(mr)::value, NR = decltype(nr)::value;
+                    LoadKernelConfig<MR, NR>(m + bi, n + bj, kb);
+                    KernelTiles<MR, NR>(A + bi * a_tile, a_stride, a_tile, a_step,
+                                        B + bj * b_tile, b_stride, b_tile, b_step,
+                                        C + bi * c_rows + bj * (COLSB / 4), c_stride, ksteps,
+                                        accumulate, prefetch);
+                });
+            }
+        }
+    }
+
+    // 计算 C 的 [i_begin, i_end) x [j_begin, j_end) 区域, K 方向为 [k_begin, k_begin + kb * ksteps)
+    // 区域内每个 (MR * 16) x (NR * 16) 块的形状相同, 因此整个区域只需要一次 tile 配置。
+    // epilogue 非空时 (K 方向的最后一次累加) 每个块存回后立即做后处理, 此时块仍在 L1 中
+    template <int MR, int NR>
+    TARGET_AMX void GemmRegion(int i_begin, int i_end, int j_begin, int j_end, int k_begin,
+                               int kb, int ksteps, const ATiles<InputType> &A,
+                               const BTiles<WeightType> &B, OutputType *C, int ldc,
+                               bool accumulate, const GemmEpilogue *epilogue) {
+        using Block = TileBlock<MR, NR>;
+        const int TM = ROWS, TN = COLSB / 4;
+        // K 尾部不是 4 的倍数且 A 未补零时, A 的 tile 会多读最多 3 字节, 先拷贝到补零的临时缓冲区
+        // 缓冲区只在这里清零一次: 每个行块只覆盖有效行的前 kb 个元素, 补齐到 G 的倍数的部分
+        // 始终为 0; 上一个行块留下的多余行不在本块 tile 的行数之内, 不会被读取
+        alignas(64) InputType a_tail[MR][16 * 64];
+        const bool copy_a = kb % G != 0 && !A.padded;
+        if (copy_a) std::memset(static_cast<void *>(a_tail), 0, sizeof(a_tail));
+        const size_t c_stride = static_cast<size_t>(ldc) * sizeof(OutputType);
+        int prefetch = prefetch_distance;
+        if (prefetch == PREFETCH_AUTO) prefetch = B.stride == 64 ? 0 : PREFETCH_DISTANCE;
+
+        for (int i = i_begin; i < i_end; i += MR * TM) {
+            int m[MR];
+            int mt = 0;
+            for (int t = 0; t < MR; ++t) {
+                m[t] = std::max(0, std::min(TM, i_end - i - t * TM));
+                if (m[t] > 0) mt = t + 1;
+            }
+            const InputType *a = A.At(i, k_begin);
+            size_t a_stride = A.stride, a_tile = A.m_step;
+            if (copy_a) {
+                for (int r = 0; r < std::min(i_end - i, MR * TM); ++r) {
+                    const InputType *row = A.At(i + r / TM * TM, k_begin);
+                    std::memcpy(&a_tail[r / TM][(r % TM) * 64],
+                                row + (r % TM) * A.stride / sizeof(InputType),
+                                kb * sizeof(InputType));
+                }
+                a = a_tail[0];
+                a_stride = 64 * sizeof(InputType);
+                a_tile = 16 * 64;
+            }
+            for (int j = j_begin; j < j_end; j += NR * TN) {
+                int n[NR];
+                int nt = 0;
+                for (int t = 0; t < NR; ++t) {
+                    n[t] = std::max(0, std::min(TN, j_end - j - t * TN));
+                    if (n[t] > 0) nt = t + 1;
+                }
+                const WeightType *b = B.At(k_begin, j);
+                OutputType *c = C + static_cast<size_t>(i) * ldc + j;
+
+                // 当前块计算期间, 以独占状态预取下一个块的 C
+                if (prefetch > 0) {
+                    const bool last_j = j + NR * TN >= j_end;
+                    if (!last_j || i + MR * TM < i_end) {
+                        const OutputType *next =
+                            last_j ? C + static_cast<size_t>(i + MR * TM) * ldc + j_begin
+                                   : c + NR * TN;
+                        for (int t = 0; t < NR; ++t) {
+                            PrefetchTile<_MM_HINT_ET0>(next + t * TN, c_stride, MR * TM);
+                        }
+                    }
+                }
+
+                // 轮流使用 tile 的一侧要求各 tile 形状相同, 否则按不完整的块处理
+                const bool uniform = Block::RESIDENT ||
+                                     (Block::A_BUFS == MR ? n[NR - 1] == n[0] : m[MR - 1] == m[0]);
+                if (mt == MR && nt == NR && uniform) {
+                    LoadKernelConfig<MR, NR>(m, n, kb);
+                    KernelTiles<MR, NR>(a, a_stride, a_tile, A.k_step, b, B.stride, B.n_step,
+                                        B.k_step, c, c_stride, ksteps, accumulate, prefetch);
+                } else {
+                    KernelEdge(mt, nt, m, n, a, a_stride, a_tile, A.k_step, b, B.stride, B.n_step,
+                               B.k_step, c, c_stride, kb, ksteps, accumulate, prefetch);
+                }
+                if (epilogue != nullptr) {
+                    ApplyEpilogueAvx512(std::min(i_end - i, MR * TM), std::min(j_end - j, NR * TN),
+                                        c, ldc, epilogue->Offset(i, j));
+                }
+            }
+        }
+    }
+
+    // C[M x N] (+)= A[M x K] * B[K x N], A/B 均以 tile 描述, 使用 MR x NR 分块。
+    // 先处理完整的 K 段, 再用另一套配置把 K 尾部累加进来; 两个阶段内部都按
+    // 内部区域 -> 右边缘 -> 下边缘 -> 右下角的顺序遍历, 使相同形状的块连续执行
+    template <int MR, int NR>
+    TARGET_AMX void GemmTiles(int M, int N, int K, const ATiles<InputType> &A,
+                              const BTiles<WeightType> &B, OutputType *C, int ldc, bool accumulate,
+                              const GemmEpilogue *epilogue) {
+        const int BM = MR * ROWS, BN = NR * (COLSB / 4);
+
+        const int k_full = K / TK * TK;
+        const int k_tail = K - k_full;
+        const int m_full = M / BM * BM;
+        const int n_full = N / BN * BN;
+
+        auto run = [&](int k_begin, int kb, int ksteps, bool acc, const GemmEpilogue *ep) {
+            auto region = [&](int i0, int i1, int j0, int j1) {
+                if (i0 < i1 && j0 < j1) {
+                    GemmRegion<MR, NR>(i0, i1, j0, j1, k_begin, kb, ksteps, A, B, C, ldc, acc, ep);
+                }
+            };
+            region(0, m_full, 0, n_full);
+            region(0, m_full, n_full, N);
+            region(m_full, M, 0, n_full);
+            region(m_full, M, n_full, N);
+        };
+        if (k_full > 0) run(0, TK, k_full / TK, accumulate, k_tail > 0 ? nullptr : epilogue);
+        if (k_tail > 0) run(k_full, k_tail, 1, accumulate || k_full > 0, epilogue);
+    }
+
+    GemmKernelShape ChooseKernel(int M, int N) const {
+        return kernel.mr != 0 ? kernel : SelectGemmKernel(M, N);
+    }
+
+    // 按 C 的形状选择分块 (SelectGemmKernel), 或使用 SetKernel 指定的分块
+    void GemmTiles(int M, int N, int K, const ATiles<InputType> &A, const BTiles<WeightType> &B,
+                   OutputType *C, int ldc, bool accumulate, const GemmEpilogue *epilogue) {
+        DispatchGemmKernel(ChooseKernel(M, N), [&](auto mr, auto nr) {
+            GemmTiles<decltype(mr)::value, decltype(nr)::value>(M, N, K, A, B, C, ldc, accumulate,
+                                                               epilogue);
+        });
+    }
+
+    // GotoBLAS 式的多级分块: jc 循环把 B 切成 KC x NC 的面板 (常驻 LLC),
+    // ic 循环把 A 的 MC x KC 块打包成连续的 tile (常驻 L2), 再交给 2x2 内核。
+    // A 本身能放进一个 MC x KC 块时不需要打包, 直接按行主序读取; A 已经是 tile 主序
+    // (A.padded) 时也不需要打包, MC、KC 都是 tile 的整数倍, 每个块直接从 A 中偏移得到
+    TARGET_AMX void GemmAmx(int M, int N, int K, const ATiles<InputType> &A,
+                            const BTiles<WeightType> &B, OutputType *C, int ldc,
+                            const GemmEpilogue *epilogue) {
+        const GemmBlocking &blocking = GetGemmBlocking();
+        const int kc_max = blocking.kc / static_cast<int>(sizeof(InputType));  // KC 按字节确定
+        if (M <= blocking.mc && K <= kc_max) {
+            GemmTiles(M, N, K, A, B, C, ldc, false, epilogue);
+            return;
+        }
+        const int lda = static_cast<int>(A.stride / sizeof(InputType));
+
+        for (int jc = 0; jc < N; jc += blocking.nc) {
+            const int nc = std::min(blocking.nc, N - jc);
+            for (int pc = 0; pc < K; pc += kc_max) {
+                const int kc = std::min(kc_max, K - pc);
+                const int k_tiles = (kc + TK - 1) / TK;
+                BTiles<WeightType> panel = B;
+                panel.data = B.At(pc, jc);
+                for (int ic = 0; ic < M; ic += blocking.mc) {
+                    const int mc = std::min(blocking.mc, M - ic);
+                    ATiles<InputType> block = A.Offset(ic, pc);
+                    if (!A.padded) {
+                        const size_t bytes = static_cast<size_t>((mc + 15) / 16) * k_tiles *
+                                             PACK_TILE_BYTES;
+                        auto *packed = static_cast<InputType *>(ThreadScratch(bytes));
+                        PackATiles(mc, kc, block.data, lda, packed);
+                        block = PackedATiles(kc, packed);
+                    }
+                    const GemmEpilogue block_epilogue =
+                        epilogue != nullptr ? epilogue->Offset(ic, jc) : GemmEpilogue{};
+                    GemmTiles(mc, nc, kc, block, panel,
+                              C + static_cast<size_t>(ic) * ldc + jc, ldc, pc > 0,
+                              epilogue != nullptr && pc + kc >= K ? &block_epilogue : nullptr);
+                }
+            }
+        }
+    }
+
+    // epilogue 非空时在 C 上做融合的后处理; AMX 后端逐块处理, 其它后端在整个 GEMM 之后处理
+    void GemmImpl(int M, int N, int K, const InputType *A, int lda, const BTiles<WeightType> &B,
+                  OutputType *C, int ldc, const GemmEpilogue *epilogue = nullptr) {
+        if (M <= 0 || N <= 0) return;
+        if (K <= 0) {
+            for (int i = 0; i < M; ++i) std::fill_n(C + static_cast<size_t>(i) * ldc, N, 0);
+            if (epilogue != nullptr) ApplyEpilogue(M, N, C, ldc, *epilogue);
+            return;
+        }
+        if (backend == GemmBackend::AMX && M <= gemv_max_m) {
+            GemvAvx512(M, N, K, A, lda, B, C, ldc);
+            if (epilogue != nullptr) ApplyEpilogue(M, N, C, ldc, *epilogue);
+            return;
+        }
+        if (backend == GemmBackend::AMX) {
+            GemmAmx(M, N, K, ATiles<InputType>::RowMajor(A, lda), B, C, ldc, epilogue);
+            return;
+        }
+        if constexpr (DOT == AmxDotOp::DPBF16PS) {
+            if (backend == GemmBackend::AVX512_BF16) {
+                GemmBf16Avx512(M, N, K, A, lda, B, C, ldc);
+            } else {
+                GemmScalar(M, N, K, A, lda, B, C, ldc);
+            }
+        } else {
+            switch (backend) {
+                case GemmBackend::AVX512_VNNI:
+                    GemmAvx512Vnni(M, N, K, A, lda, B, C, ldc);
+                    break;
+                case GemmBackend::AVX2:
+                    GemmAvx2(M, N, K, A, lda, B, C, ldc);
+                    break;
+                default:
+                    GemmScalar(M, N, K, A, lda, B, C, ldc);
+                    break;
+            }
+        }
+        if (epilogue != nullptr) ApplyEpilogue(M, N, C, ldc, *epilogue);
+    }
+
+    // A 以 tile 描述: 行主序时同上; tile 主序的 A 在 AMX 后端上直接交给 GemmAmx,
+    // GEMV 和其它后端读取行主序的 A, 先把这几行转回行主序 (线程私有的缓冲区)
+    void GemmImpl(int M, int N, int K, const ATiles<InputType> &A, const BTiles<WeightType> &B,
+                  OutputType *C, int ldc, const GemmEpilogue *epilogue = nullptr) {
+        if (!A.padded) {
+            GemmImpl(M, N, K, A.data, static_cast<int>(A.stride / sizeof(InputType)), B, C, ldc,
+                     epilogue);
+            return;
+        }
+        if (backend == GemmBackend::AMX && M > gemv_max_m && N > 0 && K > 0) {
+            GemmAmx(M, N, K, A, B, C, ldc, epilogue);
+            return;
+        }
+        static thread_local AlignedBuffer rows;
+        const size_t bytes = static_cast<size_t>(M) * std::max(K, 1) * sizeof(InputType);
+        if (rows.Bytes() < bytes) rows = AlignedBuffer(bytes);
+        auto *a = static_cast<InputType *>(rows.Data());
+        // 按 tile 行逐段拷贝: A 可能是分 K 后的一片, 各条带在 K 方向上不一定从头开始
+        for (int i = 0; i < M; ++i) {
+            for (int k = 0; k < K; k += TK) {
+                std::memcpy(a + static_cast<size_t>(i) * K + k, A.At(i, k) + i % 16 * TK,
+                            std::min(TK, K - k) * sizeof(InputType));
+            }
+        }
+        GemmImpl(M, N, K, a, K, B, C, ldc, epilogue);
+    }
+
+    // Matrix 对应的 A 描述: tile 主序的 Matrix 与打包后的 A 格式相同
+    static ATiles<InputType> MatrixTiles(const Matrix<InputType> &A) {
+        if (A.Layout() == MatrixLayout::TILE_MAJOR) return PackedATiles(A.Cols(), A.Data());
+        const int lda = static_cast<int>(A.Stride() / sizeof(InputType));
+        return ATiles<InputType>::RowMajor(A.Data(), lda);
+    }
+
+    // 把 C 划分为二维的宏块网格, 由线程池中的线程并行计算 (每个线程使用自己的 tile 状态),
+    // 所有线程共享 A 和 B; 宏块边长是 32 的倍数, 只有真正的矩阵边缘才会出现不完整的块
+    void GemmParallel(int M, int N, int K, const ATiles<InputType> &A,
+                      const BTiles<WeightType> &B, OutputType *C, int ldc, WorkerPool &pool,
+                      const GemmEpilogue *epilogue = nullptr) {
+        if (M <= 0 || N <= 0) return;
+        const int splits = ChooseSplitK(M, N, K, pool.Size());
+        if (splits > 1) {
+            GemmSplitK(M, N, K, A, B, C, ldc, pool, splits, epilogue);
+            return;
+        }
+        const int BM = 2 * ROWS, BN = 2 * (COLSB / 4);
+        const int blocks_m = (M + BM - 1) / BM;
+        const int blocks_n = (N + BN - 1) / BN;
+        const GemmGrid grid = ChooseGemmGrid(blocks_m, blocks_n, pool.Size());
+        const int mb = (blocks_m + grid.m - 1) / grid.m * BM;
+        const int nb = (blocks_n + grid.n - 1) / grid.n * BN;
+
+        pool.Run(grid.m * grid.n, [&](int task, int) {
+            const int i = task / grid.n * mb;
+            const int j = task % grid.n * nb;
+            BTiles<WeightType> panel = B;
+            panel.data = B.At(0, j);
+            const GemmEpilogue block_epilogue =
+                epilogue != nullptr ? epilogue->Offset(i, j) : GemmEpilogue{};
+            GemmImpl(std::min(mb, M - i), std::min(nb, N - j), K, A.Offset(i, 0), panel,
+                     C + static_cast<size_t>(i) * ldc + j, ldc,
+                     epilogue != nullptr ? &block_epilogue : nullptr);
+        });
+    }
+
+    // C 的 tile 太少、分不满线程时按 K 切分: 第 s 片计算 A[:, K_s] * B[K_s, :], 第 0 片直接写入 C,
+    // 其余写入各自私有的部分和 (行跨度对齐到 64 字节)。归约按行分给各线程, 每行的 splits 个
+    // 部分和按二叉树两两相加 (距离 1, 2, 4, ...), 一行的所有部分和都在 L1 中, 浮点的舍入误差
+    // 也只随层数增长。后处理需要完整的累加结果, 在归约之后逐行块进行
+    void GemmSplitK(int M, int N, int K, const ATiles<InputType> &A, const BTiles<WeightType> &B,
+                    OutputType *C, int ldc, WorkerPool &pool, int splits,
+                    const GemmEpilogue *epilogue) {
+        static thread_local AlignedBuffer scratch;
+        const int ldp = (N + 15) / 16 * 16;
+        const size_t part = static_cast<size_t>(M) * ldp;
+        const size_t bytes = (splits - 1) * part * sizeof(OutputType);
+        if (scratch.Bytes() < bytes) scratch = AlignedBuffer(bytes);
+        OutputType *partials = static_cast<OutputType *>(scratch.Data());
+        auto row = [&](int s, int i) {
+            return s == 0 ? C + static_cast<size_t>(i) * ldc
+                          : partials + (s - 1) * part + static_cast<size_t>(i) * ldp;
+        };
+
+        pool.Run(splits, [&](int s, int) {
+            const auto [k0, k1] = SplitKSlice(K, splits, s);
+            BTiles<WeightType> panel = B;
+            panel.data = B.At(k0, 0);
+            GemmImpl(M, N, k1 - k0, A.Offset(0, k0), panel, row(s, 0), s == 0 ? ldc : ldp);
+        });
+
+        const int tasks = std::min(M, pool.Size() * 4);
+        pool.Run(tasks, [&](int t, int) {
+            const int i0 = static_cast<int>(int64_t(M) * t / tasks);
+            const int i1 = static_cast<int>(int64_t(M) * (t + 1) / tasks);
+            for (int i = i0; i < i1; ++i) {
+                for (int d = 1; d < splits; d *= 2) {
+                    for (int s = 0; s + d < splits; s += 2 * d) AddRow(row(s, i), row(s + d, i), N);
+                }
+            }
+            if (epilogue != nullptr && i1 > i0) {
+                ApplyEpilogue(i1 - i0, N, row(0, i0), ldc, epilogue->Offset(i0, 0));
+            }
+        });
+    }
+
+    static GemmEpilogue WithPackedSums(const GemmEpilogue &epilogue, const PackedB<WeightType> &B) {
+        GemmEpilogue ep = epilogue;
+        ep.k = B.K();
+        if (ep.col_sums == nullptr) ep.col_sums = B.ColumnSums();
+        return ep;
+    }
+
+    static GemmEpilogue ZeroPointEpilogue(int32_t a_zero_point, OutputType *C, int ldc) {
+        static_assert(std::is_same_v<OutputType, int32_t>, "zero points need int32 output");
+        GemmEpilogue ep;
+        ep.a_zero_point = a_zero_point;
+        ep.output = EpilogueOutput::INT32;
+        ep.dst = C;
+        ep.ldd = ldc;
+        return ep;
+    }
+
+    // 一批形状相同的问题的操作数: 指针数组不为空时使用指针数组, 否则按固定跨度 (元素个数) 偏移
+    struct BatchOperands {
+        const InputType *a;
+        const InputType *const *a_list;
+        size_t stride_a;
+        const WeightType *b;
+        const WeightType *const *b_list;
+        size_t stride_b;
+        OutputType *c;
+        OutputType *const *c_list;
+        size_t stride_c;
+
+        const InputType *A(int i) const { return a_list != nullptr ? a_list[i] : a + i * stride_a; }
+        const WeightType *B(int i) const {
+            return b_list != nullptr ? b_list[i] : b + i * stride_b;
+        }
+        OutputType *C(int i) const { return c_list != nullptr ? c_list[i] : c + i * stride_c; }
+    };
+
+    // 计算第 [begin, end) 个问题。GemmTiles 对单个问题依次使用完整 K 段、K 尾部以及
+    // 内部/右边缘/下边缘/右下角各自的 tile 配置, 逐个问题调用时每个问题都要把这些配置轮换一遍;
+    // 这里把循环次序反过来, 同一种配置下先算完整批问题, 每个线程每种配置只执行一次 ldtilecfg
+    template <int MR, int NR>
+    TARGET_AMX void GemmBatchAmx(int M, int N, int K, int lda, int ldb, int ldc,
+                                 const BatchOperands &ops, int begin, int end) {
+        const int BM = MR * ROWS, BN = NR * (COLSB / 4);
+        const int k_full = K / TK * TK;
+        const int k_tail = K - k_full;
+        const int m_full = M / BM * BM;
+        const int n_full = N / BN * BN;
+        const size_t b_stride = static_cast<size_t>(ldb) * sizeof(WeightType);
+
+        auto region = [&](int i_begin, int i_end, int j_begin, int j_end, int k_begin, int kb,
+                          int ksteps, bool acc) {
+            if (i_begin >= i_end || j_begin >= j_end) return;
+            for (int p = begin; p < end; ++p) {
+                BTiles<WeightType> tiles{ops.B(p), b_stride, static_cast<size_t>(ROWS) * ldb,
+                                         static_cast<size_t>(PACK_TILE_N * G)};
+                GemmRegion<MR, NR>(i_begin, i_end, j_begin, j_end, k_begin, kb, ksteps,
+                                   ATiles<InputType>::RowMajor(ops.A(p), lda), tiles, ops.C(p),
+                                   ldc, acc, nullptr);
+            }
+        };
+        auto run = [&](int k_begin, int kb, int ksteps, bool acc) {
+            region(0, m_full, 0, n_full, k_begin, kb, ksteps, acc);
+            region(0, m_full, n_full, N, k_begin, kb, ksteps, acc);
+            region(m_full, M, 0, n_full, k_begin, kb, ksteps, acc);
+            region(m_full, M, n_full, N, k_begin, kb, ksteps, acc);
+        };
+        if (k_full > 0) run(0, TK, k_full / TK, false);
+        if (k_tail > 0) run(k_full, k_tail, 1, k_full > 0);
+    }
+
+    void GemmBatchImpl(int M, int N, int K, int lda, int ldb, int ldc, const BatchOperands &ops,
+                       int begin, int end) {
+        const GemmBlocking &blocking = GetGemmBlocking();
+        const int kc_max = blocking.kc / static_cast<int>(sizeof(InputType));
+        if (backend == GemmBackend::AMX && M > 0 && N > 0 && K > 0 && M <= blocking.mc &&
+            K <= kc_max) {
+            DispatchGemmKernel(ChooseKernel(M, N), [&](auto mr, auto nr) {
+                GemmBatchAmx<decltype(mr)::value, decltype(nr)::value>(M, N, K, lda, ldb, ldc, ops,
+                                                                       begin, end);
+            });
+            return;
+        }
+        // 较大的问题本身就能摊薄配置的开销, 逐个计算
+        const size_t b_stride = static_cast<size_t>(ldb) * sizeof(WeightType);
+        for (int p = begin; p < end; ++p) {
+            BTiles<WeightType> tiles{ops.B(p), b_stride, static_cast<size_t>(ROWS) * ldb,
+                                     static_cast<size_t>(PACK_TILE_N * G)};
+            GemmImpl(M, N, K, ops.A(p), lda, tiles, ops.C(p), ldc);
+        }
+    }
+
+    // 每组按 BATCH_TASKS_PER_THREAD * 线程数 切成连续的任务, 各组的任务依次编号;
+    // 线程池把相邻编号的任务分给同一个线程, 线程因此很少在组之间切换 tile 配置
+    static constexpr int BATCH_TASKS_PER_THREAD = 4;
+
+    struct BatchTask {
+        int group;
+        int begin;
+        int end;
+    };
+
+    static void SplitBatch(int group, int count, int threads, std::vector<BatchTask> &tasks) {
+        const int chunks = std::max(1, std::min(count, threads * BATCH_TASKS_PER_THREAD));
+        for (int t = 0; t < chunks; ++t) {
+            const int begin = static_cast<int>(static_cast<int64_t>(count) * t / chunks);
+            const int end = static_cast<int>(static_cast<int64_t>(count) * (t + 1) / chunks);
+            if (begin < end) tasks.push_back({group, begin, end});
+        }
+    }
+
+    void GemmBatchParallel(int M, int N, int K, int lda, int ldb, int ldc,
+                           const BatchOperands &ops, int batch, WorkerPool &pool) {
+        std::vector<BatchTask> tasks;
+        SplitBatch(0, batch, pool.Size(), tasks);
+        pool.Run(static_cast<int>(tasks.size()), [&](int task, int) {
+            GemmBatchImpl(M, N, K, lda, ldb, ldc, ops, tasks[task].begin, tasks[task].end);
+        });
+    }
+
+    static bool GemvSupported() {
+        const CpuFeatures &cpu = GetCpuFeatures();
+        return DOT == AmxDotOp::DPBF16PS ? cpu.avx512bf16 : cpu.avx512vnni;
+    }
+
+    int ROWS = 16;
+    int COLSB = 64;
+
+    GemmBackend backend = GemmBackend::AMX;
+    int prefetch_distance = PREFETCH_AUTO;
+    GemmKernelShape kernel{0, 0};  // {0, 0} 表示按形状自动选择
+    int split_k = 0;               // 0 表示自动选择
+    int gemv_max_m = 0;            // M 不超过它时 AMX 后端改用 GEMV 内核, 0 关闭
+
+   public:
+    // 运行时按 CPUID 选择后端: AMX-INT8 > AVX-512 VNNI > AVX2 > 标量。
+    // tile 配置在每个线程第一次计算时才加载, 因此同一个对象可以被多个线程共享
+    static IntelAmxMatrixMultiply Create() {
+        IntelAmxMatrixMultiply self;
+        self.backend = Traits::SelectBackend();
+        self.prefetch_distance = GetGemmBlocking().prefetch;
+        self.kernel = GetForcedGemmKernel();
+        if (GemvSupported()) {
+            self.gemv_max_m = DOT == AmxDotOp::DPBF16PS ? GEMV_MAX_M_BF16 : GEMV_MAX_M;
+        }
+        return self;
+    }
+
+    GemmBackend Backend() const { return backend; }
+
+    // 2x2 内核提前预取的 K tile 数, 0 关闭预取, PREFETCH_AUTO 按 B 的格式自动选择
+    void SetPrefetchDistance(int distance) {
+        prefetch_distance = std::max(PREFETCH_AUTO, distance);
+    }
+    int PrefetchDistance() const { return prefetch_distance; }
+
+    // AMX 内核的寄存器分块, 须为 GEMM_KERNELS 之一 (否则忽略); {0, 0} 恢复按形状自动选择
+    void SetKernel(GemmKernelShape shape) {
+        for (const GemmKernelShape &k : GEMM_KERNELS) {
+            if (k.mr == shape.mr && k.nr == shape.nr) kernel = shape;
+        }
+        if (shape.mr == 0 && shape.nr == 0) kernel = shape;
+    }
+    GemmKernelShape Kernel() const { return kernel; }
+
+    // 多线程时按 K 切分的片数: 0 (默认) 在 C 的 tile 数少于线程数且每片 K 不短于
+    // SPLIT_K_MIN_BYTES 时自动切分, 1 不切分, >= 2 强制切成这么多片 (不超过 K tile 数)
+    void SetSplitK(int splits) { split_k = std::max(0, splits); }
+    int SplitK() const { return split_k; }
+
+    // M 不超过 max_m 的 GEMM 在 AMX 后端上改用 AVX-512 的 GEMV 内核 (读取同一份 B),
+    // 0 关闭; CPU 不支持 AVX-512 VNNI (bf16 为 AVX512_BF16) 时忽略
+    void SetGemvMaxM(int max_m) { gemv_max_m = GemvSupported() ? std::max(0, max_m) : 0; }
+    int GemvMaxM() const { return gemv_max_m; }
+
+    // 在 threads 个线程上计算 M x N x K 时实际使用的片数, 1 表示不切分
+    int ChooseSplitK(int M, int N, int K, int threads) const {
+        const int k_tiles = (K + TK - 1) / TK;
+        if (threads <= 1 || k_tiles <= 1) return 1;
+        if (split_k > 0) return std::min(split_k, k_tiles);
+        const int64_t c_tiles = int64_t((M + ROWS - 1) / ROWS) * ((N + 15) / 16);
+        if (c_tiles >= threads) return 1;
+        const int min_k = SPLIT_K_MIN_BYTES / static_cast<int>(sizeof(InputType));
+        return std::max(1, std::min(threads, K / min_k));
+    }
+
+    // 第 s 片的 K 区间 [k0, k1): 按 K tile 均分, 只有最后一片可能含有 K 尾部
+    static std::pair<int, int> SplitKSlice(int K, int splits, int s) {
+        const int k_tiles = (K + TK - 1) / TK;
+        const int k0 = static_cast<int>(int64_t(k_tiles) * s / splits) * TK;
+        const int k1 = static_cast<int>(int64_t(k_tiles) * (s + 1) / splits) * TK;
+        return {k0, std::min(K, k1)};
+    }
+
+    // 第5版的接口, 仅在 AMX 后端可用
+    TARGET_AMX void MatrixMultiply(std::vector<Matrix<InputType>> &VA0,
+                                   std::vector<Matrix<InputType>> &VA1,
+                                   std::vector<Matrix<WeightType>> &VB0,
+                                   std::vector<Matrix<WeightType>> &VB1, Matrix<OutputType> &C00,
+                                   Matrix<OutputType> &C01, Matrix<OutputType> &C10,
+                                   Matrix<OutputType> &C11) {
+        InitTileConfig();
+        _tile_loadd(4, C00.Data(), C00.Stride());
+        _tile_loadd(5, C01.Data(), C01.Stride());
+        _tile_loadd(6, C10.Data(), C10.Stride());
+        _tile_loadd(7, C11.Data(), C11.Stride());
+
+        for (size_t k = 0; k < VA0.size(); ++k) {
+            _tile_loadd(0, VA0[k].Data(), VA0[k].Stride());  // A00(:,k)
+            _tile_loadd(1, VB0[k].Data(), VB0[k].Stride());  // B00(k,:)
+
+            _tile_loadd(2, VA1[k].Data(), VA1[k].Stride());  // A10(:,k)
+            _tile_loadd(3, VB1[k].Data(), VB1[k].Stride());  // B01(k,:)
+
+            TileDot<DOT, 4, 0, 1>();  // C00 += A00(:,k) * B00(k,:)
+            TileDot<DOT, 5, 0, 3>();  // C01 += A00(:,k) * B01(k,:)
+            TileDot<DOT, 6, 2, 1>();  // C10 += A10(:,k) * B00(k,:)
+            TileDot<DOT, 7, 2, 3>();  // C11 += A10(:,k) * B01(k,:)
+        }
+
+        // 最后一次性存回
+        _tile_stored(4, C00.Data(), C00.Stride());
+        _tile_stored(5, C01.Data(), C01.Stride());
+        _tile_stored(6, C10.Data(), C10.Stride());
+        _tile_stored(7, C11.Data(), C11.Stride());
+    }
+
+    // 第5版接口的视图版本: A0/A1 是 A 中相邻的两个 16 x K 行块, B0/B1 是 VNNI 格式 B 中相邻的
+    // 两个 (K / 4) x 64 字节的列块, 都可以是同一块大缓冲区的 SubView, 内核直接在其中逐个 tile
+    // 前进, 不需要把数据拆成 16x64 字节的小矩阵。K 须为 TK (int8 为 64, bf16 为 32) 的倍数
+    TARGET_AMX void MatrixMultiply(MatrixView<const InputType> A0, MatrixView<const InputType> A1,
+                                   MatrixView<const WeightType> B0, MatrixView<const WeightType> B1,
+                                   MatrixView<OutputType> C00, MatrixView<OutputType> C01,
+                                   MatrixView<OutputType> C10, MatrixView<OutputType> C11) {
+        InitTileConfig();
+        _tile_loadd(4, C00.Data(), C00.Stride());
+        _tile_loadd(5, C01.Data(), C01.Stride());
+        _tile_loadd(6, C10.Data(), C10.Stride());
+        _tile_loadd(7, C11.Data(), C11.Stride());
+
+        const int k_tiles = A0.Cols() / TK;
+        const int b_cols = PACK_TILE_N * G;
+        for (int k = 0; k < k_tiles; ++k) {
+            _tile_loadd(0, A0.SubView(0, k * TK, ROWS, TK).Data(), A0.Stride());
+            _tile_loadd(1, B0.SubView(k * ROWS, 0, ROWS, b_cols).Data(), B0.Stride());
+
+            _tile_loadd(2, A1.SubView(0, k * TK, ROWS, TK).Data(), A1.Stride());
+            _tile_loadd(3, B1.SubView(k * ROWS, 0, ROWS, b_cols).Data(), B1.Stride());
+
+            TileDot<DOT, 4, 0, 1>();
+            TileDot<DOT, 5, 0, 3>();
+            TileDot<DOT, 6, 2, 1>();
+            TileDot<DOT, 7, 2, 3>();
+        }
+
+        _tile_stored(4, C00.Data(), C00.Stride());
+        _tile_stored(5, C01.Data(), C01.Stride());
+        _tile_stored(6, C10.Data(), C10.Stride());
+        _tile_stored(7, C11.Data(), C11.Stride());
+    }
+
+    // 任意形状的 C[M x N] = A[M x K] * B[K x N]
+    //   A: 行主序, 行跨度 lda (元素个数)
+    //   B: VNNI 格式, 每列的 G 个连续 K 元素 (int8 为 4 个, bf16 为 2 个) 交织成 4 字节,
+    //      共 (K + G - 1) / G 行, 每行 N * G 个元素, 行跨度 ldb (元素个数, >= G * N);
+    //      K 不是 G 的倍数时最后一行不足部分须为 0
+    //   C: 行主序, 行跨度 ldc (元素个数)
+    // 内部区域使用 2x2 寄存器分块, M/N/K 的尾部通过缩小 tile 的 rows/colsb 处理, 不做补齐拷贝
+    void Gemm(int M, int N, int K, const InputType *A, int lda, const WeightType *B, int ldb,
+              OutputType *C, int ldc) {
+        const size_t b_stride = static_cast<size_t>(ldb) * sizeof(WeightType);
+        BTiles<WeightType> tiles{B, b_stride, static_cast<size_t>(ROWS) * ldb,
+                                static_cast<size_t>(PACK_TILE_N * G)};
+        GemmImpl(M, N, K, A, lda, tiles, C, ldc);
+    }
+
+    // B 为预打包的权重: 每个 B tile 都是连续的 1KB 块, 打包的开销在多次调用间摊薄
+    void Gemm(int M, const InputType *A, int lda, const PackedB<WeightType> &B, OutputType *C,
+              int ldc) {
+        GemmImpl(M, B.N(), B.K(), A, lda, B.Tiles(), C, ldc);
+    }
+
+    // A、C 为视图 (可以是更大矩阵的 SubView), 行跨度须为元素大小的整数倍
+    void Gemm(MatrixView<const InputType> A, const PackedB<WeightType> &B,
+              MatrixView<OutputType> C) {
+        Gemm(A.Rows(), A.Data(), static_cast<int>(A.Stride() / sizeof(InputType)), B, C.Data(),
+             static_cast<int>(C.Stride() / sizeof(OutputType)));
+    }
+
+    // A 为 Matrix, 行主序或 tile 主序均可; tile 主序的 A 在 AMX 后端上不再打包
+    void Gemm(const Matrix<InputType> &A, const PackedB<WeightType> &B, OutputType *C, int ldc) {
+        GemmImpl(A.Rows(), B.N(), B.K(), MatrixTiles(A), B.Tiles(), C, ldc);
+    }
+
+    // C 也为 Matrix (须为行主序)
+    void Gemm(const Matrix<InputType> &A, const PackedB<WeightType> &B, Matrix<OutputType> &C) {
+        assert(C.Layout() == MatrixLayout::ROW_MAJOR);
+        Gemm(A, B, C.Data(), C.Cols());
+    }
+
+    // 多线程版本: 一个 GEMM 按二维宏块网格分给线程池并行计算
+    void Gemm(int M, int N, int K, const InputType *A, int lda, const WeightType *B, int ldb,
+              OutputType *C, int ldc, WorkerPool &pool) {
+        const size_t b_stride = static_cast<size_t>(ldb) * sizeof(WeightType);
+        BTiles<WeightType> tiles{B, b_stride, static_cast<size_t>(ROWS) * ldb,
+                                static_cast<size_t>(PACK_TILE_N * G)};
+        GemmParallel(M, N, K, ATiles<InputType>::RowMajor(A, lda), tiles, C, ldc, pool);
+    }
+
+    void Gemm(int M, const InputType *A, int lda, const PackedB<WeightType> &B, OutputType *C,
+              int ldc, WorkerPool &pool) {
+        GemmParallel(M, B.N(), B.K(), ATiles<InputType>::RowMajor(A, lda), B.Tiles(), C, ldc, pool);
+    }
+
+    void Gemm(const Matrix<InputType> &A, const PackedB<WeightType> &B, OutputType *C, int ldc,
+              WorkerPool &pool) {
+        GemmParallel(A.Rows(), B.N(), B.K(), MatrixTiles(A), B.Tiles(), C, ldc, pool);
+    }
+
+    void Gemm(const Matrix<InputType> &A, const PackedB<WeightType> &B, Matrix<OutputType> &C,
+              WorkerPool &pool) {
+        assert(C.Layout() == MatrixLayout::ROW_MAJOR);
+        Gemm(A, B, C.Data(), C.Cols(), pool);
+    }
+
+    // 带融合后处理的版本: C 仍是 int32 累加结果 (也是后处理的输入), 最终结果写入 epilogue.dst。
+    // 设置了 a_zero_point 而没有给出 col_sums 时使用 B 打包时计算的列和
+    void Gemm(int M, const InputType *A, int lda, const PackedB<WeightType> &B, OutputType *C,
+              int ldc, const GemmEpilogue &epilogue) {
+        const GemmEpilogue ep = WithPackedSums(epilogue, B);
+        GemmImpl(M, B.N(), B.K(), A, lda, B.Tiles(), C, ldc, &ep);
+    }
+
+    void Gemm(int M, const InputType *A, int lda, const PackedB<WeightType> &B, OutputType *C,
+              int ldc, const GemmEpilogue &epilogue, WorkerPool &pool) {
+        const GemmEpilogue ep = WithPackedSums(epilogue, B);
+        GemmParallel(M, B.N(), B.K(), ATiles<InputType>::RowMajor(A, lda), B.Tiles(), C, ldc, pool,
+                     &ep);
+    }
+
+    // A 为零点是 a_zero_point 的非对称量化数据 (通常是 uint8 激活):
+    // C = (A - a_zero_point) * B, 补偿在每个块存回后原地完成
+    void Gemm(int M, const InputType *A, int lda, int32_t a_zero_point,
+              const PackedB<WeightType> &B, OutputType *C, int ldc) {
+        Gemm(M, A, lda, B, C, ldc, ZeroPointEpilogue(a_zero_point, C, ldc));
+    }
+
+    void Gemm(int M, const InputType *A, int lda, int32_t a_zero_point,
+              const PackedB<WeightType> &B, OutputType *C, int ldc, WorkerPool &pool) {
+        Gemm(M, A, lda, B, C, ldc, ZeroPointEpilogue(a_zero_point, C, ldc), pool);
+    }
+
+    // 一批形状相同的独立小 GEMM: C_p = A_p * B_p, p 取 [0, batch)。
+    // 第 p 个问题的操作数为 A + p * stride_a、B + p * stride_b、C + p * stride_c (元素个数),
+    // stride_b 为 0 时所有问题共享同一个 B; B 为 VNNI 格式, 与原始 B 版本的 Gemm 相同
+    void GemmBatched(int M, int N, int K, const InputType *A, int lda, size_t stride_a,
+                     const WeightType *B, int ldb, size_t stride_b, OutputType *C, int ldc,
+                     size_t stride_c, int batch) {
+        const BatchOperands ops{A, nullptr, stride_a, B, nullptr, stride_b, C, nullptr, stride_c};
+        GemmBatchImpl(M, N, K, lda, ldb, ldc, ops, 0, batch);
+    }
+
+    void GemmBatched(int M, int N, int K, const InputType *A, int lda, size_t stride_a,
+                     const WeightType *B, int ldb, size_t stride_b, OutputType *C, int ldc,
+                     size_t stride_c, int batch, WorkerPool &pool) {
+        const BatchOperands ops{A, nullptr, stride_a, B, nullptr, stride_b, C, nullptr, stride_c};
+        GemmBatchParallel(M, N, K, lda, ldb, ldc, ops, batch, pool);
+    }
+
+    // 指针数组版本: 第 p 个问题的操作数为 A[p]、B[p]、C[p]
+    void GemmBatched(int M, int N, int K, const InputType *const *A, int lda,
+                     const WeightType *const *B, int ldb, OutputType *const *C, int ldc,
+                     int batch) {
+        const BatchOperands ops{nullptr, A, 0, nullptr, B, 0, nullptr, C, 0};
+        GemmBatchImpl(M, N, K, lda, ldb, ldc, ops, 0, batch);
+    }
+
+    void GemmBatched(int M, int N, int K, const InputType *const *A, int lda,
+                     const WeightType *const *B, int ldb, OutputType *const *C, int ldc, int batch,
+                     WorkerPool &pool) {
+        const BatchOperands ops{nullptr, A, 0, nullptr, B, 0, nullptr, C, 0};
+        GemmBatchParallel(M, N, K, lda, ldb, ldc, ops, batch, pool);
+    }
+
+    // GemmGrouped 的一组: count 个形状相同的问题, 操作数以指针数组给出
+    struct GemmGroup {
+        int M;
+        int N;
+        int K;
+        const InputType *const *A;
+        int lda;
+        const WeightType *const *B;
+        int ldb;
+        OutputType *const *C;
+        int ldc;
+        int count;
+    };
+
+    // 一次调用计算若干组形状不同的批量 GEMM, 每组内部同 GemmBatched
+    void GemmGrouped(const GemmGroup *groups, int group_count) {
+        for (int g = 0; g < group_count; ++g) {
+            const GemmGroup &gr = groups[g];
+            const BatchOperands ops{nullptr, gr.A, 0, nullptr, gr.B, 0, nullptr, gr.C, 0};
+            GemmBatchImpl(gr.M, gr.N, gr.K, gr.lda, gr.ldb, gr.ldc, ops, 0, gr.count);
+        }
+    }
+
+    // 多线程版本: 所有组的任务一起分给线程池, 小组不会让其余线程空等
+    void GemmGrouped(const GemmGroup *groups, int group_count, WorkerPool &pool) {
+        std::vector<BatchTask> tasks;
+        for (int g = 0; g < group_count; ++g) {
+            SplitBatch(g, groups[g].count, pool.Size(), tasks);
+        }
+        pool.Run(static_cast<int>(tasks.size()), [&](int task, int) {
+            const BatchTask &t = tasks[task];
+            const GemmGroup &gr = groups[t.group];
+            const BatchOperands ops{nullptr, gr.A, 0, nullptr, gr.B, 0, nullptr, gr.C, 0};
+            GemmBatchImpl(gr.M, gr.N, gr.K, gr.lda, gr.ldb, gr.ldc, ops, t.begin, t.end);
+        });
+    }
+
+    bool SetTileDataUse() { return RequestAmxPermission(); }
+
+    // 释放调用线程的 tile 状态; 线程退出时也会自动释放
+    void TileRelease() {
+        if (backend == GemmBackend::AMX) AmxThreadContext::Current().Release();
+    }
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+
+#include "amx_memory.h"
+
+template <typename DataType>
+class MatrixView;
+
+// 矩阵的存储布局:
+//   ROW_MAJOR  行主序, 行跨度为 cols * sizeof(T)
+//   TILE_MAJOR 每 16 行 x 64 字节为一个连续的 1KB tile; 每 16 行为一条, 条内的 tile 按列的
+//              顺序存放, 边缘不足的部分补 0。_tile_loadd 的行跨度为 64 字节, 一个 tile 只访问
+//              连续的 16 个缓存行, 不会跨页; 与 PackATiles 打包后的 A 格式相同
+enum class MatrixLayout { ROW_MAJOR, TILE_MAJOR };
+
+constexpr int MATRIX_TILE_ROWS = 16;
+constexpr int MATRIX_TILE_BYTES = 1024;
+
+// 行主序或 tile 主序的矩阵, 数据起始地址 64 字节对齐 (缓存行 / tile 行)。
+// 只能移动不能拷贝: 之前的浅拷贝会在 vector 扩容时重复释放同一块内存。
+// 传入 MatrixArena 时从内存池中分配, 矩阵不拥有内存, 由内存池统一回收;
+// 否则单独分配, 2MB 以上的矩阵使用大页
+template <typename DataType>
+class Matrix {
+   private:
+    static constexpr int TILE_COLS = 64 / sizeof(DataType);  // 一个 tile 行的元素个数
+
+    int rows;
+    int cols;
+    MatrixLayout layout;
+    AlignedBuffer storage;  // 来自内存池时为空
+    DataType *data;
+
+    static size_t Bytes(int rows, int cols, MatrixLayout layout) {
+        if (layout == MatrixLayout::ROW_MAJOR) {
+            return static_cast<size_t>(rows) * cols * sizeof(DataType);
+        }
+        return static_cast<size_t>((rows + MATRIX_TILE_ROWS - 1) / MATRIX_TILE_ROWS) *
+               ((cols + TILE_COLS - 1) / TILE_COLS) * MATRIX_TILE_BYTES;
+    }
+
+    // tile 主序的补齐部分须为 0 (内核按整个 tile 读取)
+    void ClearPadding() {
+        if (layout == MatrixLayout::TILE_MAJOR) std::memset(static_cast<void *>(data), 0, Bytes());
+    }
+
+   public:
+    Matrix(int rows, int cols, MatrixLayout layout = MatrixLayout::ROW_MAJOR)
+        : rows(rows),
+          cols(cols),
+          layout(layout),
+          storage(Bytes(rows, cols, layout)),
+          data(static_cast<DataType *>(storage.Data())) {
+        ClearPadding();
+    }
+
+    Matrix(int rows, int cols, MatrixArena &arena, MatrixLayout layout = MatrixLayout::ROW_MAJOR)
+        : rows(rows),
+          cols(cols),
+          layout(layout),
+          data(static_cast<DataType *>(arena.Allocate(Bytes(rows, cols, layout)))) {
+        ClearPadding();
+    }
+
+    Matrix(const Matrix &) = delete;
+    Matrix &operator=(const Matrix &) = delete;
+
+    Matrix(Matrix &&other) noexcept
+        : rows(std::exchange(other.rows, 0)),
+          cols(std::exchange(other.cols, 0)),
+          layout(other.layout),
+          storage(std::move(other.storage)),
+          data(std::exchange(other.data, nullptr)) {}
+
+    Matrix &operator=(Matrix &&other) noexcept {
+        if (this != &other) {
+            rows = std::exchange(other.rows, 0);
+            cols = std::exchange(other.cols, 0);
+            layout = other.layout;
+            storage = std::move(other.storage);
+            data = std::exchange(other.data, nullptr);
+        }
+        return *this;
+    }
+
+    // 行主序时为行跨度; tile 主序时为 tile 内的行跨度 (64 字节), 配合 Tile() 加载 tile
+    size_t Stride() const {
+        return layout == MatrixLayout::ROW_MAJOR ? this->cols * sizeof(DataType) : 64;
+    }
+    DataType *Data() const { return data; }
+    int Rows() const { return rows; }
+    int Cols() const { return cols; }
+    MatrixLayout Layout() const { return layout; }
+
+    int Size() const { return rows * cols; }
+
+    // 占用的字节数, tile 主序时包括补齐的部分
+    size_t Bytes() const { return Bytes(rows, cols, layout); }
+
+    // tile 主序: 每条 (16 行) 的 tile 数, 以及第 rt 条、第 ct 个 tile 的起始地址
+    int ColTiles() const { return (cols + TILE_COLS - 1) / TILE_COLS; }
+    DataType *Tile(int rt, int ct) const {
+        constexpr size_t TILE_ELEMENTS = MATRIX_TILE_BYTES / sizeof(DataType);
+        return data + (static_cast<size_t>(rt) * ColTiles() + ct) * TILE_ELEMENTS;
+    }
+
+    // 第 r 行第 c 列的元素, 两种布局通用 (逐元素访问, 只用于初始化和检查)
+    DataType &At(int r, int c) const {
+        if (layout == MatrixLayout::ROW_MAJOR) return data[static_cast<size_t>(r) * cols + c];
+        DataType *tile = Tile(r / MATRIX_TILE_ROWS, c / TILE_COLS);
+        return tile[r % MATRIX_TILE_ROWS * TILE_COLS + c % TILE_COLS];
+    }
+
+    // 只适用于行主序: tile 主序的 Stride() 是 tile 内的行跨度, 不能当作行主序的视图
+    MatrixView<DataType> View() const {
+        assert(layout == MatrixLayout::ROW_MAJOR);
+        return {data, rows, cols, Stride()};
+    }
+
+    // 用于初始化
+    void Fill(DataType value) {
+        for (int i = 0; i < rows; ++i) {
+            for (int j = 0; j < cols; ++j) At(i, j) = value;
+        }
+    }
+
+    // 打印矩阵
+    void Print_t() const {
+        for (int i = 0; i < rows; ++i) {
+            for (int j = 0; j < cols; ++j) {
+                std::cout << static_cast<int>(At(i, j)) << " ";
+            }
+            std::cout << "\n";
+        }
+
+        std::cout << "\n";
+    }
+};
+
+// 不拥有内存的矩阵视图: 起始地址、行数、列数和以字节为单位的行跨度。
+// SubView 在同一块行主序缓冲区内切出子块, 不做任何拷贝, 可以直接作为 tile 的加载地址
+template <typename DataType>
+class MatrixView {
+   private:
+    DataType *data = nullptr;
+    int rows = 0;
+    int cols = 0;
+    size_t stride = 0;
+
+   public:
+    MatrixView() = default;
+    MatrixView(DataType *data, int rows, int cols, size_t stride)
+        : data(data), rows(rows), cols(cols), stride(stride) {}
+
+    // MatrixView<T> 可以隐式转换为 MatrixView<const T>
+    template <typename Other,
+              typename = std::enable_if_t<std::is_convertible_v<Other *, DataType *>>>
+    MatrixView(const MatrixView<Other> &other)
+        : MatrixView(other.Data(), other.Rows(), other.Cols(), other.Stride()) {}
+
+    // Matrix 须为行主序。显式转换: 隐式转换会让 tile 主序的 Matrix 悄悄匹配视图版本的接口
+    template <typename Other,
+              typename = std::enable_if_t<std::is_convertible_v<Other *, DataType *>>>
+    explicit MatrixView(const Matrix<Other> &matrix)
+        : MatrixView(matrix.Data(), matrix.Rows(), matrix.Cols(), matrix.Stride()) {
+        assert(matrix.Layout() == MatrixLayout::ROW_MAJOR);
+    }
+
+    size_t Stride() const { return stride; }
+    DataType *Data() const { return data; }
+    int Rows() const { return rows; }
+    int Cols() const { return cols; }
+
+    DataType *Row(int r) const {
+        using Byte = std::conditional_t<std::is_const_v<DataType>, const char, char>;
+        return reinterpret_cast<DataType *>(reinterpret_cast<Byte *>(data) + r * stride);
+    }
+    DataType &operator()(int r, int c) const { return Row(r)[c]; }
+
+    // 从第 r 行、第 c 列开始的 h x w 子块, 行跨度不变
+    MatrixView SubView(int r, int c, int h, int w) const { return {Row(r) + c, h, w, stride}; }
+};
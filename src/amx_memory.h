@@ -0,0 +1,140 @@
+#pragma once
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+constexpr size_t CACHE_LINE_BYTES = 64;
+constexpr size_t HUGE_PAGE_BYTES = size_t(2) << 20;
+
+// 64 字节对齐 (缓存行 / tile 行) 的内存块。不小于 2MB 且 huge_pages 为 true 时用 mmap 分配:
+// 优先使用预留的 2MB 大页 (MAP_HUGETLB), 没有预留时按 2MB 对齐映射并建议内核使用透明大页,
+// 大操作数的 TLB 缺失因此大幅减少
+class AlignedBuffer {
+   private:
+    void *data = nullptr;
+    size_t bytes = 0;
+    size_t mapped = 0;  // mmap 的长度, 0 表示来自 aligned_alloc
+
+    static void *MapHugePages(size_t length) {
+        void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) return p;
+
+        // 多映射 2MB, 再裁掉首尾, 得到 2MB 对齐的区域
+        p = mmap(nullptr, length + HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return nullptr;
+        const uintptr_t base = reinterpret_cast<uintptr_t>(p);
+        const uintptr_t aligned = (base + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+        if (aligned > base) munmap(p, aligned - base);
+        const size_t tail = base + HUGE_PAGE_BYTES - aligned;
+        if (tail > 0) munmap(reinterpret_cast<void *>(aligned + length), tail);
+        madvise(reinterpret_cast<void *>(aligned), length, MADV_HUGEPAGE);
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    void Reset() {
+        if (mapped != 0) {
+            munmap(data, mapped);
+        } else {
+            std::free(data);
+        }
+        data = nullptr;
+        bytes = 0;
+        mapped = 0;
+    }
+
+   public:
+    AlignedBuffer() = default;
+
+    explicit AlignedBuffer(size_t size, bool huge_pages = true) : bytes(size) {
+        if (size == 0) return;
+        if (huge_pages && size >= HUGE_PAGE_BYTES) {
+            const size_t length = (size + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+            data = MapHugePages(length);
+            if (data != nullptr) {
+                mapped = length;
+                return;
+            }
+        }
+        const size_t rounded = (size + CACHE_LINE_BYTES - 1) / CACHE_LINE_BYTES * CACHE_LINE_BYTES;
+        data = std::aligned_alloc(CACHE_LINE_BYTES, rounded);
+        if (data == nullptr) throw std::bad_alloc();  // 与 new 一样, 分配失败时抛出异常
+    }
+
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    AlignedBuffer(AlignedBuffer &&other) noexcept
+        : data(std::exchange(other.data, nullptr)),
+          bytes(std::exchange(other.bytes, 0)),
+          mapped(std::exchange(other.mapped, 0)) {}
+
+    AlignedBuffer &operator=(AlignedBuffer &&other) noexcept {
+        if (this != &other) {
+            Reset();
+            data = std::exchange(other.data, nullptr);
+            bytes = std::exchange(other.bytes, 0);
+            mapped = std::exchange(other.mapped, 0);
+        }
+        return *this;
+    }
+
+    ~AlignedBuffer() { Reset(); }
+
+    void *Data() const { return data; }
+    size_t Bytes() const { return bytes; }
+    bool HugePages() const { return mapped != 0; }
+};
+
+// 矩阵子块的内存池: 从大块 (默认 2MB, 大页) 中顺序切分 64 字节对齐的内存,
+// 创建成千上万个子块时不再逐个调用堆分配。Reset() 之后已有的大块会被重复使用
+class MatrixArena {
+   private:
+    std::vector<AlignedBuffer> chunks;
+    size_t chunk_bytes;
+    bool huge_pages;
+    size_t current = 0;  // 正在切分的大块
+    size_t offset = 0;   // 当前大块中已使用的字节数
+
+   public:
+    explicit MatrixArena(size_t chunk_size = HUGE_PAGE_BYTES, bool use_huge_pages = true)
+        : chunk_bytes(chunk_size), huge_pages(use_huge_pages) {}
+
+    MatrixArena(const MatrixArena &) = delete;
+    MatrixArena &operator=(const MatrixArena &) = delete;
+
+    void *Allocate(size_t size) {
+        size = (size + CACHE_LINE_BYTES - 1) / CACHE_LINE_BYTES * CACHE_LINE_BYTES;
+        while (current < chunks.size() && offset + size > chunks[current].Bytes()) {
+            ++current;
+            offset = 0;
+        }
+        if (current == chunks.size()) {
+            chunks.emplace_back(std::max(chunk_bytes, size), huge_pages);
+            offset = 0;
+        }
+        void *p = static_cast<char *>(chunks[current].Data()) + offset;
+        offset += size;
+        return p;
+    }
+
+    // 释放所有子块 (不归还内存), 之前分配的指针全部失效
+    void Reset() {
+        current = 0;
+        offset = 0;
+    }
+
+    size_t ReservedBytes() const {
+        size_t total = 0;
+        for (const auto &chunk : chunks) total += chunk.Bytes();
+        return total;
+    }
+};
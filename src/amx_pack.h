@@ -0,0 +1,404 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "amx_bfloat16.h"
+#include "amx_cpu.h"
+#include "amx_matrix.h"
+#include "amx_memory.h"
+
+// B 操作数在 _tile_dpbssd 中的 tile 几何: 每个 tile 为 16 行 x 64 字节,
+// 对应 K 方向 64 个元素、N 方向 16 列 (每列 4 个连续的 K 元素交织存放)
+constexpr int PACK_TILE_K = 64;
+constexpr int PACK_TILE_N = 16;
+constexpr int PACK_TILE_BYTES = 1024;
+
+// 一般的元素类型: tile 的一行 (64 字节) 在 K 方向容纳 TILE_K 个元素, B 的 VNNI 格式中每列
+// 以 4 字节为一组, 交织 VNNI_GROUP 个连续的 K 元素 (int8 为 4 个, bf16 为 2 个)
+template <typename DataType>
+constexpr int TILE_K = 64 / sizeof(DataType);
+template <typename DataType>
+constexpr int VNNI_GROUP = 4 / sizeof(DataType);
+template <typename DataType>
+constexpr int TILE_ELEMENTS = PACK_TILE_BYTES / sizeof(DataType);
+
+// B 操作数中 tile 的寻址方式: (k, j) 所在 tile 的地址为
+// data + k / TILE_K * k_step + j / 16 * n_step (元素个数), tile 的行跨度为 stride 字节
+template <typename DataType>
+struct BTiles {
+    const DataType *data;
+    size_t stride;
+    size_t k_step;
+    size_t n_step;
+
+    const DataType *At(int k, int j) const {
+        return data + k / TILE_K<DataType> * k_step + j / PACK_TILE_N * n_step;
+    }
+
+    // 第 j 列、包含第 k 个元素的 4 字节组 (VNNI 的一个 32 位元素)
+    const DataType *Group(int k, int j) const {
+        constexpr int G = VNNI_GROUP<DataType>;
+        return At(k, j) + (k % TILE_K<DataType>) / G * (stride / sizeof(DataType)) +
+               (j % PACK_TILE_N) * G;
+    }
+};
+
+// A 操作数中 tile 的寻址方式: (i, k) 所在 tile (16 行 x 64 字节) 的地址为
+// data + i / 16 * m_step + k / TILE_K * k_step, tile 的行跨度为 stride 字节;
+// padded 表示 K 方向已经补零到 tile 边界 (打包后的 A), 读取尾部 tile 时不会越界
+template <typename DataType>
+struct ATiles {
+    const DataType *data;
+    size_t stride;
+    size_t m_step;
+    size_t k_step;
+    bool padded;
+
+    const DataType *At(int i, int k) const {
+        return data + i / 16 * m_step + k / TILE_K<DataType> * k_step;
+    }
+
+    // 行主序的 A, 行跨度 lda (元素个数)
+    static ATiles RowMajor(const DataType *A, int lda) {
+        const size_t stride = static_cast<size_t>(lda) * sizeof(DataType);
+        return {A, stride, 16 * static_cast<size_t>(lda), TILE_K<DataType>, false};
+    }
+
+    // 从第 i 行、第 k 列开始的子矩阵; 打包的 A 要求 i、k 落在 tile 的边界上
+    ATiles Offset(int i, int k) const {
+        if (padded) return {At(i, k), stride, m_step, k_step, true};
+        const size_t ld = stride / sizeof(DataType);
+        return {data + i * ld + k, stride, m_step, k_step, false};
+    }
+};
+
+// 把行主序 A 的一个 M x K 块打包成 tile 连续排列的格式: 每 16 行为一条,
+// 条内 K 方向的 tile 依次存放, 每个 tile 为 1KB 的连续块, 不足部分补 0。
+// 打包后的块常驻 L2, 内核对它的每次 tileloadd 都只访问连续的 16 个缓存行
+TARGET_AVX512 inline void PackATiles(int M, int K, const int8_t *A, int lda, int8_t *dst) {
+    const int k_tiles = (K + PACK_TILE_K - 1) / PACK_TILE_K;
+    const int m_tiles = (M + 15) / 16;
+    for (int mt = 0; mt < m_tiles; ++mt) {
+        for (int kt = 0; kt < k_tiles; ++kt) {
+            int8_t *tile = dst + (static_cast<size_t>(mt) * k_tiles + kt) * PACK_TILE_BYTES;
+            const int kk = std::min(PACK_TILE_K, K - kt * PACK_TILE_K);
+            const __mmask64 mask = kk == 64 ? ~__mmask64(0) : (__mmask64(1) << kk) - 1;
+            for (int r = 0; r < 16; ++r) {
+                const int i = mt * 16 + r;
+                const int8_t *src = A + static_cast<size_t>(i) * lda + kt * PACK_TILE_K;
+                __m512i v = i < M ? _mm512_maskz_loadu_epi8(mask, src) : _mm512_setzero_si512();
+                _mm512_store_si512(tile + r * 64, v);
+            }
+        }
+    }
+}
+
+// 打包只是按字节搬运 tile 的各行, 其它元素类型按字节处理即可
+template <typename DataType>
+inline void PackATiles(int M, int K, const DataType *A, int lda, DataType *dst) {
+    PackATiles(M, K * static_cast<int>(sizeof(DataType)), reinterpret_cast<const int8_t *>(A),
+               lda * static_cast<int>(sizeof(DataType)), reinterpret_cast<int8_t *>(dst));
+}
+
+template <typename DataType>
+inline ATiles<DataType> PackedATiles(int K, const DataType *packed) {
+    const int k_tiles = (K + TILE_K<DataType> - 1) / TILE_K<DataType>;
+    return {packed, 64, static_cast<size_t>(k_tiles) * TILE_ELEMENTS<DataType>,
+            TILE_ELEMENTS<DataType>, true};
+}
+
+// PackATiles 的逆过程: 把 tile 连续排列的 M x K 块写回行主序 (行跨度 ldd), 只写有效部分
+TARGET_AVX512 inline void UnpackATiles(int M, int K, const int8_t *src, int8_t *dst, int ldd) {
+    const int k_tiles = (K + PACK_TILE_K - 1) / PACK_TILE_K;
+    for (int i = 0; i < M; ++i) {
+        const int8_t *strip = src + static_cast<size_t>(i / 16) * k_tiles * PACK_TILE_BYTES;
+        int8_t *row = dst + static_cast<size_t>(i) * ldd;
+        for (int kt = 0; kt < k_tiles; ++kt) {
+            const int kk = std::min(PACK_TILE_K, K - kt * PACK_TILE_K);
+            const __mmask64 mask = kk == 64 ? ~__mmask64(0) : (__mmask64(1) << kk) - 1;
+            const __m512i v = _mm512_load_si512(strip + kt * PACK_TILE_BYTES + i % 16 * 64);
+            _mm512_mask_storeu_epi8(row + kt * PACK_TILE_K, mask, v);
+        }
+    }
+}
+
+template <typename DataType>
+inline void UnpackATiles(int M, int K, const DataType *src, DataType *dst, int ldd) {
+    UnpackATiles(M, K * static_cast<int>(sizeof(DataType)), reinterpret_cast<const int8_t *>(src),
+                 reinterpret_cast<int8_t *>(dst), ldd * static_cast<int>(sizeof(DataType)));
+}
+
+// 线程私有的 64 字节对齐临时缓冲区, 按需增长, 在同一线程的多次调用间复用
+inline void *ThreadScratch(size_t bytes) {
+    static thread_local AlignedBuffer buffer;
+    if (buffer.Bytes() < bytes) buffer = AlignedBuffer(bytes);
+    return buffer.Data();
+}
+
+// 把行主序 K x N 的 int8 矩阵 B 转成按 tile 排列的 VNNI 格式:
+// 先按 N 方向的 tile 分列, 每列内 K 方向的 tile 连续存放, 每个 tile 是 1KB 的连续块,
+// 边缘不足的部分补 0。dst 需 64 字节对齐, 大小为 n_tiles * k_tiles * 1KB
+//
+// 每次处理 4 行 x 64 列: 先用 unpack 在每个 128 位 lane 内完成 4 字节交织,
+// 再做 4x4 的 lane 转置, 得到 4 个 N tile 各自的一行 (64 字节)。
+// row_at(k, j) 返回第 k 行从第 j 列 (64 的倍数) 开始的 64 字节, 行主序和 tile 主序的 B
+// 只在这里不同
+template <typename RowAt>
+TARGET_AVX512 inline void PackBVnniRows(int K, int N, const RowAt &row_at, int8_t *dst) {
+    const int k_tiles = (K + PACK_TILE_K - 1) / PACK_TILE_K;
+    const size_t panel_bytes = static_cast<size_t>(k_tiles) * PACK_TILE_BYTES;
+
+    for (int k = 0; k < k_tiles * PACK_TILE_K; k += 4) {
+        const int kt = k / PACK_TILE_K;
+        const int row = (k % PACK_TILE_K) / 4;
+        for (int j = 0; j < N; j += 64) {
+            const int nn = std::min(64, N - j);
+            const __mmask64 mask = nn == 64 ? ~__mmask64(0) : (__mmask64(1) << nn) - 1;
+            __m512i x[4];
+            for (int q = 0; q < 4; ++q) {
+                x[q] = k + q < K ? _mm512_maskz_loadu_epi8(mask, row_at(k + q, j))
+                                 : _mm512_setzero_si512();
+            }
+            __m512i t0 = _mm512_unpacklo_epi8(x[0], x[1]);
+            __m512i t1 = _mm512_unpackhi_epi8(x[0], x[1]);
+            __m512i t2 = _mm512_unpacklo_epi8(x[2], x[3]);
+            __m512i t3 = _mm512_unpackhi_epi8(x[2], x[3]);
+            __m512i u0 = _mm512_unpacklo_epi16(t0, t2);  // 每个 lane 的第 0-3 列
+            __m512i u1 = _mm512_unpackhi_epi16(t0, t2);  // 第 4-7 列
+            __m512i u2 = _mm512_unpacklo_epi16(t1, t3);  // 第 8-11 列
+            __m512i u3 = _mm512_unpackhi_epi16(t1, t3);  // 第 12-15 列
+            __m512i v0 = _mm512_shuffle_i64x2(u0, u1, 0x44);
+            __m512i v1 = _mm512_shuffle_i64x2(u0, u1, 0xEE);
+            __m512i v2 = _mm512_shuffle_i64x2(u2, u3, 0x44);
+            __m512i v3 = _mm512_shuffle_i64x2(u2, u3, 0xEE);
+            __m512i out[4] = {
+                _mm512_shuffle_i64x2(v0, v2, 0x88),
+                _mm512_shuffle_i64x2(v0, v2, 0xDD),
+                _mm512_shuffle_i64x2(v1, v3, 0x88),
+                _mm512_shuffle_i64x2(v1, v3, 0xDD),
+            };
+            for (int l = 0; l < 4 && j + l * PACK_TILE_N < N; ++l) {
+                const int nt = j / PACK_TILE_N + l;
+                int8_t *tile = dst + nt * panel_bytes + static_cast<size_t>(kt) * PACK_TILE_BYTES;
+                _mm512_store_si512(tile + row * 64, out[l]);
+            }
+        }
+    }
+}
+
+inline void PackBVnni(int K, int N, const int8_t *B, int ldb, int8_t *dst) {
+    PackBVnniRows(
+        K, N, [&](int k, int j) { return B + static_cast<size_t>(k) * ldb + j; }, dst);
+}
+
+// bf16 的 B 按 2 个 K 元素一组交织: 每次处理 2 行 x 32 列, unpack 在每个 128 位 lane 内
+// 完成交织, 再用 permutex2var 把 lane 排回列的顺序, 得到 2 个 N tile 各自的一行。
+// row_at 与 PackBVnniRows 相同, j 为 32 的倍数
+template <typename RowAt>
+TARGET_AVX512 inline void PackBVnniBf16Rows(int K, int N, const RowAt &row_at, bfloat16 *dst) {
+    constexpr int TK = TILE_K<bfloat16>;
+    const int k_tiles = (K + TK - 1) / TK;
+    const size_t panel = static_cast<size_t>(k_tiles) * TILE_ELEMENTS<bfloat16>;
+    const __m512i lo_index = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+    const __m512i hi_index = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+
+    for (int k = 0; k < k_tiles * TK; k += 2) {
+        const int kt = k / TK;
+        const int row = (k % TK) / 2;
+        for (int j = 0; j < N; j += 32) {
+            const int nn = std::min(32, N - j);
+            const __mmask32 mask = nn == 32 ? ~__mmask32(0) : (__mmask32(1) << nn) - 1;
+            __m512i x[2];
+            for (int q = 0; q < 2; ++q) {
+                x[q] = k + q < K ? _mm512_maskz_loadu_epi16(mask, row_at(k + q, j))
+                                 : _mm512_setzero_si512();
+            }
+            __m512i lo = _mm512_unpacklo_epi16(x[0], x[1]);  // 每个 lane 的第 0-3 列
+            __m512i hi = _mm512_unpackhi_epi16(x[0], x[1]);  // 第 4-7 列
+            __m512i out[2] = {
+                _mm512_permutex2var_epi64(lo, lo_index, hi),
+                _mm512_permutex2var_epi64(lo, hi_index, hi),
+            };
+            for (int l = 0; l < 2 && j + l * PACK_TILE_N < N; ++l) {
+                const int nt = j / PACK_TILE_N + l;
+                bfloat16 *tile = dst + nt * panel + static_cast<size_t>(kt) * (PACK_TILE_BYTES / 2);
+                _mm512_store_si512(tile + row * 32, out[l]);
+            }
+        }
+    }
+}
+
+inline void PackBVnniBf16(int K, int N, const bfloat16 *B, int ldb, bfloat16 *dst) {
+    PackBVnniBf16Rows(
+        K, N, [&](int k, int j) { return B + static_cast<size_t>(k) * ldb + j; }, dst);
+}
+
+// 行主序 <-> tile 主序的转换, 返回新的矩阵。tile 主序的一条 (16 行) 正是 PackATiles 的输出,
+// 有 AVX-512 时按 64 字节的 tile 行整行搬运, 否则逐元素复制
+template <typename DataType>
+inline Matrix<DataType> ConvertLayout(const Matrix<DataType> &src, MatrixLayout layout) {
+    Matrix<DataType> dst(src.Rows(), src.Cols(), layout);
+    if (layout == src.Layout()) {
+        std::memcpy(dst.Data(), src.Data(), src.Bytes());
+    } else if (GetCpuFeatures().avx512bw && layout == MatrixLayout::TILE_MAJOR) {
+        PackATiles(src.Rows(), src.Cols(), src.Data(), src.Cols(), dst.Data());
+    } else if (GetCpuFeatures().avx512bw) {
+        UnpackATiles(src.Rows(), src.Cols(), src.Data(), dst.Data(), dst.Cols());
+    } else {
+        for (int i = 0; i < src.Rows(); ++i) {
+            for (int j = 0; j < src.Cols(); ++j) dst.At(i, j) = src.At(i, j);
+        }
+    }
+    return dst;
+}
+
+// 没有 AVX-512 的机器上使用的标量版本, 输出格式与 PackBVnni / PackBVnniBf16 相同
+template <typename DataType>
+inline void PackBVnniScalar(int K, int N, const DataType *B, int ldb, DataType *dst) {
+    constexpr int TK = TILE_K<DataType>, G = VNNI_GROUP<DataType>;
+    const int k_tiles = (K + TK - 1) / TK;
+    const int n_tiles = (N + PACK_TILE_N - 1) / PACK_TILE_N;
+    const size_t panel = static_cast<size_t>(k_tiles) * TILE_ELEMENTS<DataType>;
+    std::memset(static_cast<void *>(dst), 0, panel * n_tiles * sizeof(DataType));
+    for (int k = 0; k < K; ++k) {
+        const size_t offset = static_cast<size_t>(k / TK) * TILE_ELEMENTS<DataType> +
+                              (k % TK) / G * (PACK_TILE_N * G) + k % G;
+        for (int j = 0; j < N; ++j) {
+            dst[j / PACK_TILE_N * panel + offset + (j % PACK_TILE_N) * G] =
+                B[static_cast<size_t>(k) * ldb + j];
+        }
+    }
+}
+
+// 预打包的 B 操作数 (权重): 构造时打包一次, 之后在多次 Gemm 调用间复用。
+// 整数权重同时计算每列的和, 供 A 有零点 (非对称量化) 时在后处理中补偿。
+// 也可以只引用别处已经打包好的数据 (Wrap, 如 mmap 的权重文件), 此时不拥有内存
+template <typename DataType>
+class PackedB {
+   private:
+    int k;
+    int n;
+    int k_tiles;
+    int n_tiles;
+    AlignedBuffer storage;  // 2MB 以上的权重使用大页; 引用外部数据时为空
+    const DataType *data;
+    std::vector<int32_t> col_sums;
+
+    PackedB(int K, int N, bool allocate = true)
+        : k(K),
+          n(N),
+          k_tiles((K + TILE_K<DataType> - 1) / TILE_K<DataType>),
+          n_tiles((N + PACK_TILE_N - 1) / PACK_TILE_N),
+          storage(allocate ? Bytes() : 0),
+          data(static_cast<const DataType *>(storage.Data())) {}
+
+    DataType *MutableData() { return static_cast<DataType *>(storage.Data()); }
+
+    // row_at(k, j) 返回 B 第 k 行从第 j 列 (64 字节的倍数) 开始的 64 字节
+    template <typename RowAt>
+    void PackRows(const RowAt &row_at) {
+        if constexpr (std::is_same_v<DataType, bfloat16>) {
+            PackBVnniBf16Rows(k, n, row_at, MutableData());
+        } else {
+            // 打包只搬运字节, uint8 与 int8 相同
+            PackBVnniRows(
+                k, n,
+                [&](int kk, int j) { return reinterpret_cast<const int8_t *>(row_at(kk, j)); },
+                reinterpret_cast<int8_t *>(MutableData()));
+        }
+    }
+
+    void PackRowMajor(const DataType *B, int ldb) {
+        if (!GetCpuFeatures().avx512bw) {
+            PackBVnniScalar(k, n, B, ldb, MutableData());
+        } else {
+            PackRows([&](int kk, int j) { return B + static_cast<size_t>(kk) * ldb + j; });
+        }
+        if constexpr (std::is_integral_v<DataType>) {
+            col_sums.assign(n, 0);
+            for (int kk = 0; kk < k; ++kk) {
+                const DataType *row = B + static_cast<size_t>(kk) * ldb;
+                for (int j = 0; j < n; ++j) col_sums[j] += row[j];
+            }
+        }
+    }
+
+   public:
+    // B: 行主序 K x N, 行跨度 ldb (元素个数)
+    PackedB(int K, int N, const DataType *B, int ldb) : PackedB(K, N) { PackRowMajor(B, ldb); }
+
+    // B 为 K x N 的 Matrix: tile 主序时 B 的每一行都由 tile 行 (64 字节) 组成, 直接按 tile 行
+    // 打包, 不需要行主序的副本; 没有 AVX-512 时先转回行主序
+    explicit PackedB(const Matrix<DataType> &B) : PackedB(B.Rows(), B.Cols()) {
+        if (B.Layout() == MatrixLayout::ROW_MAJOR) {
+            PackRowMajor(B.Data(), n);
+            return;
+        }
+        if (!GetCpuFeatures().avx512bw) {
+            PackRowMajor(ConvertLayout(B, MatrixLayout::ROW_MAJOR).Data(), n);
+            return;
+        }
+        constexpr int TC = TILE_K<DataType>;  // 一个 tile 行的元素个数
+        PackRows([&](int kk, int j) { return B.Tile(kk / 16, j / TC) + kk % 16 * TC; });
+        if constexpr (std::is_integral_v<DataType>) {
+            col_sums.assign(n, 0);
+            for (int kk = 0; kk < k; ++kk) {
+                for (int j = 0; j < n; ++j) col_sums[j] += B.At(kk, j);
+            }
+        }
+    }
+
+    // 引用已按本类格式打包的 K x N 数据 (Bytes() 字节, 64 字节对齐), 不复制; packed 须在
+    // 返回的对象使用期间保持有效。整数类型的 col_sums 为长度 N 的列和, 为空时不支持 A 的零点
+    static PackedB Wrap(int K, int N, const DataType *packed, const int32_t *col_sums = nullptr) {
+        PackedB b(K, N, false);
+        b.data = packed;
+        if (col_sums != nullptr) b.col_sums.assign(col_sums, col_sums + N);
+        return b;
+    }
+
+    // 移动后 AlignedBuffer 的地址不变, data 仍然有效
+    PackedB(PackedB &&) = default;
+    PackedB &operator=(PackedB &&) = default;
+
+    int K() const { return k; }
+    int N() const { return n; }
+    int KTiles() const { return k_tiles; }
+    int NTiles() const { return n_tiles; }
+    size_t Bytes() const { return static_cast<size_t>(k_tiles) * n_tiles * PACK_TILE_BYTES; }
+    const DataType *Data() const { return data; }
+    // 是否拥有打包数据 (Wrap 得到的对象为 false)
+    bool OwnsData() const { return storage.Data() != nullptr; }
+
+    // 每列 K 个元素的和 (长度 N), 仅整数类型
+    const int32_t *ColumnSums() const { return col_sums.empty() ? nullptr : col_sums.data(); }
+
+    // 第 kt 个 K tile、第 nt 个 N tile 的起始地址 (1KB 连续块, 行跨度 64 字节)
+    const DataType *Tile(int kt, int nt) const {
+        return Data() + (static_cast<size_t>(nt) * k_tiles + kt) * TILE_ELEMENTS<DataType>;
+    }
+
+    BTiles<DataType> Tiles() const {
+        return {Data(), PACK_TILE_N * 4, TILE_ELEMENTS<DataType>,
+                static_cast<size_t>(k_tiles) * TILE_ELEMENTS<DataType>};
+    }
+};
+
+// A 每行 K 个元素的和, 供 B 有零点时在后处理中补偿 (GemmEpilogue::row_sums)
+template <typename DataType>
+inline void RowSums(int M, int K, const DataType *A, int lda, int32_t *sums) {
+    for (int i = 0; i < M; ++i) {
+        const DataType *a = A + static_cast<size_t>(i) * lda;
+        int32_t sum = 0;
+        for (int k = 0; k < K; ++k) sum += a[k];
+        sums[i] = sum;
+    }
+}
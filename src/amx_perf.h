@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cpuid.h>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 基于 perf_event_open 的硬件计数器: 为进程中的每个线程 (主线程和线程池的工作线程) 各打开一组
+// 计数器, 只统计用户态, 读数时对所有线程求和。虚拟机或权限不足 (perf_event_paranoid) 时
+// 打不开的计数器标记为不可用, 不影响其余计数器和计时
+struct PerfEventSpec {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+};
+
+struct PerfReading {
+    const char *name;
+    bool available;
+    double value;  // 按 time_enabled / time_running 换算, 计数器被轮换复用时为估计值
+};
+
+// Sapphire Rapids / Emerald Rapids 上的 AMX 事件 (原始编码 umask << 8 | event):
+//   EXE.AMX_BUSY (0xB7/0x10) TMUL 忙碌的周期数; AMX_OPS_RETIRED.INT8/BF16 (0xCE/0x01, 0x02)
+//   退休的 AMX 乘加运算数。其它 CPU 上的同一编码含义不同, 因此只在这两种型号上打开
+inline bool HasSapphireRapidsAmxEvents() {
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx) || ebx != 0x756e6547) return false;  // "Genu"
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+    const unsigned family = (eax >> 8) & 0xF;
+    const unsigned model = ((eax >> 4) & 0xF) | ((eax >> 12) & 0xF0);
+    return family == 6 && (model == 0x8F || model == 0xCF);
+}
+
+inline std::vector<PerfEventSpec> DefaultPerfEvents() {
+    auto cache = [](uint64_t cache, uint64_t op, uint64_t result) {
+        return cache | (op << 8) | (result << 16);
+    };
+    std::vector<PerfEventSpec> events = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"l1d_misses", PERF_TYPE_HW_CACHE,
+         cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+               PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {"l2_misses", PERF_TYPE_RAW, 0x3F24},  // L2_RQSTS.MISS (Skylake 及之后的 Intel)
+        {"llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {"dtlb_misses", PERF_TYPE_HW_CACHE,
+         cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+               PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    };
+    if (HasSapphireRapidsAmxEvents()) {
+        events.push_back({"amx_busy_cycles", PERF_TYPE_RAW, 0x10B7});
+        events.push_back({"amx_int8_ops", PERF_TYPE_RAW, 0x01CE});
+        events.push_back({"amx_bf16_ops", PERF_TYPE_RAW, 0x02CE});
+    }
+    return events;
+}
+
+// 当前进程所有线程的 tid (/proc/self/task)
+inline std::vector<pid_t> ProcessThreadIds() {
+    std::vector<pid_t> tids;
+    if (DIR *dir = opendir("/proc/self/task")) {
+        while (dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] == '.') continue;
+            tids.push_back(static_cast<pid_t>(std::atoi(entry->d_name)));
+        }
+        closedir(dir);
+    }
+    return tids;
+}
+
+class PerfCounters {
+   private:
+    std::vector<PerfEventSpec> events;
+    std::vector<std::vector<int>> fds;  // fds[e] 为事件 e 在各线程上的计数器
+
+    static int Open(const PerfEventSpec &spec, pid_t tid) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = spec.type;
+        attr.config = spec.config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+    }
+
+    void Control(unsigned long request) {
+        for (const auto &list : fds) {
+            for (int fd : list) ioctl(fd, request, 0);
+        }
+    }
+
+   public:
+    // 在给定的线程上打开 events; 某个事件只要有一个线程打不开就整体视为不可用
+    explicit PerfCounters(const std::vector<pid_t> &tids,
+                          std::vector<PerfEventSpec> specs = DefaultPerfEvents())
+        : events(std::move(specs)), fds(events.size()) {
+        for (size_t e = 0; e < events.size(); ++e) {
+            for (pid_t tid : tids) {
+                const int fd = Open(events[e], tid);
+                if (fd < 0) {
+                    for (int opened : fds[e]) close(opened);
+                    fds[e].clear();
+                    break;
+                }
+                fds[e].push_back(fd);
+            }
+        }
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    ~PerfCounters() {
+        for (const auto &list : fds) {
+            for (int fd : list) close(fd);
+        }
+    }
+
+    bool AnyAvailable() const {
+        for (const auto &list : fds) {
+            if (!list.empty()) return true;
+        }
+        return false;
+    }
+
+    void Reset() { Control(PERF_EVENT_IOC_RESET); }
+    void Enable() { Control(PERF_EVENT_IOC_ENABLE); }
+    void Disable() { Control(PERF_EVENT_IOC_DISABLE); }
+
+    // 自上次 Reset 以来的累计值, 对所有线程求和
+    std::vector<PerfReading> Read() const {
+        std::vector<PerfReading> readings;
+        for (size_t e = 0; e < events.size(); ++e) {
+            PerfReading r{events[e].name, !fds[e].empty(), 0.0};
+            for (int fd : fds[e]) {
+                uint64_t values[3] = {};  // 计数值, time_enabled, time_running
+                if (read(fd, values, sizeof(values)) != sizeof(values)) {
+                    r.available = false;
+                    break;
+                }
+                if (values[2] != 0) r.value += double(values[0]) * values[1] / values[2];
+            }
+            readings.push_back(r);
+        }
+        return readings;
+    }
+};
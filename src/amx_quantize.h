@@ -0,0 +1,240 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "amx_cpu.h"
+#include "amx_epilogue.h"
+#include "amx_gemm.h"
+#include "amx_memory.h"
+#include "amx_pack.h"
+#include "amx_thread_pool.h"
+#include "amx_weight_file.h"
+
+// fp32 -> int8 的对称量化: q = saturate(round(x / step)), step = max|x| / 127。
+// 全 0 的数据 step 为 0, 量化结果全为 0。舍入为就近偶数 (默认的 MXCSR), 标量和 AVX-512
+// 版本的结果逐位相同
+inline float SymmetricStep(float max_abs) { return max_abs / 127.0f; }
+
+inline float InverseStep(float step) { return step > 0.0f ? 1.0f / step : 0.0f; }
+
+inline float MaxAbsScalar(int n, const float *x) {
+    float m = 0.0f;
+    for (int i = 0; i < n; ++i) m = std::max(m, std::fabs(x[i]));
+    return m;
+}
+
+TARGET_AVX512 inline float MaxAbsAvx512(int n, const float *x) {
+    __m512 m = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) m = _mm512_max_ps(m, _mm512_abs_ps(_mm512_loadu_ps(x + i)));
+    if (i < n) {
+        const __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+        m = _mm512_max_ps(m, _mm512_abs_ps(_mm512_maskz_loadu_ps(mask, x + i)));
+    }
+    return _mm512_reduce_max_ps(m);
+}
+
+inline void QuantizeRowScalar(int n, const float *x, float inv_step, int8_t *q) {
+    for (int i = 0; i < n; ++i) {
+        const int32_t v = static_cast<int32_t>(std::nearbyint(x[i] * inv_step));
+        q[i] = static_cast<int8_t>(std::clamp(v, -128, 127));
+    }
+}
+
+// 16 个元素一组: 乘以 1/step, 转换为 int32 (就近偶数), 饱和窄化为 int8 后带掩码存储
+TARGET_AVX512 inline void QuantizeRowAvx512(int n, const float *x, float inv_step, int8_t *q) {
+    const __m512 inv = _mm512_set1_ps(inv_step);
+    for (int i = 0; i < n; i += 16) {
+        const __mmask16 mask = static_cast<__mmask16>((1u << std::min(16, n - i)) - 1);
+        const __m512 v = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, x + i), inv);
+        _mm512_mask_cvtsepi32_storeu_epi8(q + i, mask, _mm512_cvtps_epi32(v));
+    }
+}
+
+inline float MaxAbs(int n, const float *x) {
+    return GetCpuFeatures().avx512bw ? MaxAbsAvx512(n, x) : MaxAbsScalar(n, x);
+}
+
+inline void QuantizeRow(int n, const float *x, float inv_step, int8_t *q) {
+    if (GetCpuFeatures().avx512bw) {
+        QuantizeRowAvx512(n, x, inv_step, q);
+    } else {
+        QuantizeRowScalar(n, x, inv_step, q);
+    }
+}
+
+// 激活 (A) 的量化粒度: 每张量一个步长, 或每行一个步长 (动态量化, 每次调用按实际数据计算)
+enum class QuantGranularity { PER_TENSOR, PER_ROW };
+
+// 把 M x K 的 fp32 矩阵 X (行跨度 ldx) 量化为 int8 矩阵 q (行跨度 ldq), steps 为每行的步长
+// (长度 M, 每张量量化时各行相同)。按行分给线程池: 每行的最大值和量化连续进行, 一行的数据
+// 第二遍读取时仍在 L1 中; 每张量量化多一次归约, 第二遍时才能开始量化
+inline void QuantizeActivations(int M, int K, const float *X, int ldx, QuantGranularity granularity,
+                                int8_t *q, int ldq, float *steps, WorkerPool *pool = nullptr) {
+    auto for_rows = [&](const auto &fn) {
+        if (pool == nullptr || M == 1) {
+            fn(0, M);
+            return;
+        }
+        const int tasks = std::min(M, pool->Size() * 4);
+        pool->Run(tasks, [&](int t, int) {
+            fn(static_cast<int>(int64_t(M) * t / tasks),
+               static_cast<int>(int64_t(M) * (t + 1) / tasks));
+        });
+    };
+    auto row = [&](int i) { return X + static_cast<size_t>(i) * ldx; };
+    auto out = [&](int i) { return q + static_cast<size_t>(i) * ldq; };
+    if (granularity == QuantGranularity::PER_ROW) {
+        for_rows([&](int i0, int i1) {
+            for (int i = i0; i < i1; ++i) {
+                steps[i] = SymmetricStep(MaxAbs(K, row(i)));
+                QuantizeRow(K, row(i), InverseStep(steps[i]), out(i));
+            }
+        });
+        return;
+    }
+    for_rows([&](int i0, int i1) {
+        for (int i = i0; i < i1; ++i) steps[i] = MaxAbs(K, row(i));  // 先暂存每行的最大值
+    });
+    const float step = SymmetricStep(M > 0 ? *std::max_element(steps, steps + M) : 0.0f);
+    std::fill(steps, steps + M, step);
+    for_rows([&](int i0, int i1) {
+        for (int i = i0; i < i1; ++i) QuantizeRow(K, row(i), InverseStep(step), out(i));
+    });
+}
+
+// fp32 的线性层 Y = act(X * W + bias) 的 int8 实现, 一次调用完成三步:
+//   1. X 按行 (或整张量) 动态量化为 int8, 步长随每次调用的数据而定;
+//   2. 与按输出通道量化并预打包的权重做 s8s8 GEMM (AMX 后端或回退后端);
+//   3. 在 GEMM 的融合后处理中反量化: y = acc * step_x[i] * step_w[j] + bias[j], 再做激活。
+// 反量化在每个块存回后立即进行, int32 累加结果不再被单独遍历一遍。
+// 权重 W 为行主序的 K x N (与 PackedB 相同), 每列 (输出通道) 一个对称量化的步长。
+// 实例持有量化后的 A 和累加结果的缓冲区, 不能被多个线程同时调用
+class QuantizedLinear {
+   private:
+    using Multiply = IntelAmxMatrixMultiply<int8_t, int32_t>;
+
+    std::vector<float> weight_steps;  // 长度 N, 须在 weights 之前构造
+    PackedB<int8_t> weights;
+    std::vector<float> bias;  // 为空时不加偏置
+    QuantGranularity granularity;
+    EpilogueActivation activation = EpilogueActivation::NONE;
+    Multiply multiply;
+    AlignedBuffer a_buffer;  // 量化后的 X, M x K
+    AlignedBuffer c_buffer;  // int32 累加结果, M x N
+    std::vector<float> a_steps;
+
+    // 每列的最大绝对值逐行更新, 按行访问 W
+    static PackedB<int8_t> QuantizeWeights(int K, int N, const float *W, int ldw,
+                                           std::vector<float> &steps) {
+        std::vector<float> max_abs(N, 0.0f);
+        for (int k = 0; k < K; ++k) {
+            const float *row = W + static_cast<size_t>(k) * ldw;
+            for (int j = 0; j < N; ++j) max_abs[j] = std::max(max_abs[j], std::fabs(row[j]));
+        }
+        steps.resize(N);
+        std::vector<float> inv(N);
+        for (int j = 0; j < N; ++j) {
+            steps[j] = SymmetricStep(max_abs[j]);
+            inv[j] = InverseStep(steps[j]);
+        }
+        std::vector<int8_t> q(static_cast<size_t>(K) * N);
+        for (int k = 0; k < K; ++k) {
+            const float *row = W + static_cast<size_t>(k) * ldw;
+            for (int j = 0; j < N; ++j) {
+                const int32_t v = static_cast<int32_t>(std::nearbyint(row[j] * inv[j]));
+                q[static_cast<size_t>(k) * N + j] = static_cast<int8_t>(std::clamp(v, -127, 127));
+            }
+        }
+        return PackedB<int8_t>(K, N, q.data(), N);
+    }
+
+    void Prepare(int M) {
+        const size_t a_bytes = static_cast<size_t>(M) * K();
+        const size_t c_bytes = static_cast<size_t>(M) * N() * sizeof(int32_t);
+        if (a_buffer.Bytes() < a_bytes) a_buffer = AlignedBuffer(a_bytes);
+        if (c_buffer.Bytes() < c_bytes) c_buffer = AlignedBuffer(c_bytes);
+        a_steps.resize(M);
+    }
+
+    GemmEpilogue Dequantize(float *Y, int ldy) const {
+        GemmEpilogue ep;
+        ep.row_scales = a_steps.data();
+        ep.scales = weight_steps.data();
+        ep.bias = Bias();
+        ep.activation = activation;
+        ep.output = EpilogueOutput::FP32;
+        ep.dst = Y;
+        ep.ldd = ldy;
+        return ep;
+    }
+
+   public:
+    // W: 行主序 K x N, 行跨度 ldw; bias 长度 N, 可以为空
+    QuantizedLinear(int K, int N, const float *W, int ldw, const float *bias_values = nullptr,
+                    QuantGranularity granularity = QuantGranularity::PER_ROW)
+        : weights(QuantizeWeights(K, N, W, ldw, weight_steps)),
+          granularity(granularity),
+          multiply(Multiply::Create()) {
+        if (bias_values != nullptr) bias.assign(bias_values, bias_values + N);
+    }
+
+    // 使用已量化并打包的权重, 如 MappedWeights<int8_t> 加载的文件 (steps 为文件中的 Scales()):
+    // 只引用 packed 的数据, 不复制, packed 须在本对象使用期间保持有效
+    QuantizedLinear(const PackedB<int8_t> &packed, const float *steps,
+                    const float *bias_values = nullptr,
+                    QuantGranularity granularity = QuantGranularity::PER_ROW)
+        : weight_steps(steps, steps + packed.N()),
+          weights(PackedB<int8_t>::Wrap(packed.K(), packed.N(), packed.Data(),
+                                        packed.ColumnSums())),
+          granularity(granularity),
+          multiply(Multiply::Create()) {
+        if (bias_values != nullptr) bias.assign(bias_values, bias_values + packed.N());
+    }
+
+    // 把量化后的权重和每通道步长写成权重文件, 供下次启动时用 MappedWeights 直接映射
+    bool SaveWeights(const std::string &path, std::string *error = nullptr) const {
+        return SaveWeightFile(path, weights, weight_steps.data(), error);
+    }
+
+    int K() const { return weights.K(); }
+    int N() const { return weights.N(); }
+    const PackedB<int8_t> &Weights() const { return weights; }
+    const float *WeightSteps() const { return weight_steps.data(); }
+    const float *Bias() const { return bias.empty() ? nullptr : bias.data(); }
+    // 最近一次调用中 X 每行的量化步长
+    const float *InputSteps() const { return a_steps.data(); }
+    QuantGranularity Granularity() const { return granularity; }
+    GemmBackend Backend() const { return multiply.Backend(); }
+
+    // 在反量化之后融合的激活 (CLAMP 的范围使用 GemmEpilogue 的默认值)
+    void SetActivation(EpilogueActivation act) { activation = act; }
+    EpilogueActivation Activation() const { return activation; }
+
+    // X: M x K, 行跨度 ldx; Y: M x N, 行跨度 ldy
+    void Forward(int M, const float *X, int ldx, float *Y, int ldy) {
+        Prepare(M);
+        auto *a = static_cast<int8_t *>(a_buffer.Data());
+        QuantizeActivations(M, K(), X, ldx, granularity, a, K(), a_steps.data());
+        multiply.Gemm(M, a, K(), weights, static_cast<int32_t *>(c_buffer.Data()), N(),
+                      Dequantize(Y, ldy));
+    }
+
+    // 多线程版本: 量化按行、GEMM 按宏块网格分给线程池
+    void Forward(int M, const float *X, int ldx, float *Y, int ldy, WorkerPool &pool) {
+        Prepare(M);
+        auto *a = static_cast<int8_t *>(a_buffer.Data());
+        QuantizeActivations(M, K(), X, ldx, granularity, a, K(), a_steps.data(), &pool);
+        multiply.Gemm(M, a, K(), weights, static_cast<int32_t *>(c_buffer.Data()), N(),
+                      Dequantize(Y, ldy), pool);
+    }
+
+    void TileRelease() { multiply.TileRelease(); }
+};
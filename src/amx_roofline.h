@@ -0,0 +1,351 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#include "amx_gemm.h"
+#include "amx_memory.h"
+#include "amx_thread_pool.h"
+
+// 屋顶线模型 (roofline): 一次调用的运算量除以搬运的字节数为计算强度 (ops/byte),
+// 可达到的性能为 min(TMUL 峰值, 强度 x 带宽)。字节数分两层统计:
+//   tile 层: 内核中 tileloadd/tilestored 搬运的字节 (按每个 tile 实际的 rows x colsb 计),
+//            受 L1/L2 到 tile 寄存器的带宽限制, 反映寄存器分块是否足够大;
+//   内存层: A、B 各读一次、C 写一次的最少字节, 受内存带宽限制, 反映问题本身的计算强度。
+// 各层的带宽和 TMUL 峰值都在本机上用微基准测得
+
+// 一次调用中 tile 指令的条数和搬运的字节数
+struct TileTraffic {
+    int64_t loads = 0;
+    int64_t stores = 0;
+    int64_t dots = 0;
+    int64_t load_bytes = 0;
+    int64_t store_bytes = 0;
+
+    int64_t Bytes() const { return load_bytes + store_bytes; }
+
+    TileTraffic &operator+=(const TileTraffic &other) {
+        loads += other.loads;
+        stores += other.stores;
+        dots += other.dots;
+        load_bytes += other.load_bytes;
+        store_bytes += other.store_bytes;
+        return *this;
+    }
+
+    TileTraffic &operator*=(int64_t times) {
+        loads *= times;
+        stores *= times;
+        dots *= times;
+        load_bytes *= times;
+        store_bytes *= times;
+        return *this;
+    }
+};
+
+// 一次 KernelTiles 调用: mt 个 A tile (rows[i] 行) 与 nt 个 B tile (cols[j] 列) 沿 K 方向
+// 累加 ksteps 次, 每次 K 步的 A tile 为 kb_bytes 字节宽, B tile 为 VNNI 格式 (kb_bytes / 4 行)。
+// C tile 在开头加载 (accumulate) 或清零, 结尾存回
+inline void AddKernelTraffic(const int *rows, int mt, const int *cols, int nt, int kb_bytes,
+                             int ksteps, bool accumulate, TileTraffic &t) {
+    const int64_t a_colsb = (kb_bytes + 3) / 4 * 4;
+    const int64_t b_rows = (kb_bytes + 3) / 4;
+    for (int i = 0; i < mt; ++i) {
+        for (int j = 0; j < nt; ++j) {
+            const int64_t c_bytes = int64_t(rows[i]) * cols[j] * 4;
+            if (accumulate) {
+                t.loads += 1;
+                t.load_bytes += c_bytes;
+            }
+            t.stores += 1;
+            t.store_bytes += c_bytes;
+        }
+    }
+    for (int i = 0; i < mt; ++i) t.load_bytes += ksteps * rows[i] * a_colsb;
+    for (int j = 0; j < nt; ++j) t.load_bytes += ksteps * b_rows * cols[j] * 4;
+    t.loads += int64_t(ksteps) * (mt + nt);
+    t.dots += int64_t(ksteps) * mt * nt;
+}
+
+// 与 IntelAmxMatrixMultiply::GemmTiles 相同的遍历: 完整 K 段和 K 尾部各一遍, 每遍按
+// MR x NR 的块计算, 不完整的块 (以及轮流使用 tile 的一侧形状不一致的块) 拆成不超过 2x2 的子块
+inline void AddGemmTilesTraffic(int M, int N, int K, int element_bytes, GemmKernelShape kernel,
+                                bool accumulate, TileTraffic &t) {
+    if (kernel.mr == 0) kernel = SelectGemmKernel(M, N);
+    const int MR = kernel.mr, NR = kernel.nr;
+    const int TK = 64 / element_bytes;
+    const int k_full = K / TK * TK;
+    const int k_tail = K - k_full;
+    const bool resident = MR + NR <= 8 - MR * NR;
+
+    auto run = [&](int kb, int ksteps, bool acc) {
+        for (int i = 0; i < M; i += MR * 16) {
+            for (int j = 0; j < N; j += NR * 16) {
+                int rows[4], cols[4];
+                int mt = 0, nt = 0;
+                for (int s = 0; s < MR; ++s) {
+                    rows[s] = std::max(0, std::min(16, M - i - s * 16));
+                    if (rows[s] > 0) mt = s + 1;
+                }
+                for (int s = 0; s < NR; ++s) {
+                    cols[s] = std::max(0, std::min(16, N - j - s * 16));
+                    if (cols[s] > 0) nt = s + 1;
+                }
+                const bool uniform =
+                    resident || (MR <= NR ? cols[NR - 1] == cols[0] : rows[MR - 1] == rows[0]);
+                if (mt == MR && nt == NR && uniform) {
+                    AddKernelTraffic(rows, mt, cols, nt, kb * element_bytes, ksteps, acc, t);
+                    continue;
+                }
+                for (int bi = 0; bi < mt; bi += 2) {
+                    for (int bj = 0; bj < nt; bj += 2) {
+                        AddKernelTraffic(rows + bi, std::min(2, mt - bi), cols + bj,
+                                         std::min(2, nt - bj), kb * element_bytes, ksteps, acc,
+                                         t);
+                    }
+                }
+            }
+        }
+    };
+    if (k_full > 0) run(TK, k_full / TK, accumulate);
+    if (k_tail > 0) run(k_tail, 1, accumulate || k_full > 0);
+}
+
+// 单线程调用 Gemm 时 AMX 后端的 tile 流量: 与 GemmAmx 相同地按 NC/KC/MC 分块,
+// kernel 为 {0, 0} 时每个块按自身形状选择分块。A 的打包和预取不是 tile 指令, 不计入;
+// 多线程时各线程分到的子问题分块方式相同, 流量与单线程基本一致
+inline TileTraffic GemmTileTraffic(int M, int N, int K, int element_bytes, GemmKernelShape kernel,
+                                   const GemmBlocking &blocking = GetGemmBlocking()) {
+    TileTraffic t;
+    const int kc_max = blocking.kc / element_bytes;
+    if (M <= blocking.mc && K <= kc_max) {
+        AddGemmTilesTraffic(M, N, K, element_bytes, kernel, false, t);
+        return t;
+    }
+    for (int jc = 0; jc < N; jc += blocking.nc) {
+        const int nc = std::min(blocking.nc, N - jc);
+        for (int pc = 0; pc < K; pc += kc_max) {
+            const int kc = std::min(kc_max, K - pc);
+            for (int ic = 0; ic < M; ic += blocking.mc) {
+                const int mc = std::min(blocking.mc, M - ic);
+                AddGemmTilesTraffic(mc, nc, kc, element_bytes, kernel, pc > 0, t);
+            }
+        }
+    }
+    return t;
+}
+
+// ---------------- 微基准 ----------------
+
+// 本机的各项上限, 带宽单位为 GB/s, 不可测 (没有 AMX) 时为 0
+struct RooflineCeilings {
+    int threads = 1;
+    double int8_gops = 0;     // tdpbssd 的峰值
+    double bf16_gflops = 0;   // tdpbf16ps 的峰值
+    double l1_tile_gbps = 0;  // 数据在 L1 中时 tileloadd 的带宽
+    double l2_tile_gbps = 0;  // 数据在 L2 中时 tileloadd 的带宽
+    double memory_gbps = 0;   // 远大于 LLC 的缓冲区的读带宽
+};
+
+namespace roofline_detail {
+
+// 8 个 tile 都配置为 16 行 x 64 字节
+TARGET_AMX inline void LoadFullTileConfig() {
+    __tile_config tileinfo{};
+    tileinfo.palette_id = 1;
+    for (int i = 0; i < 8; ++i) {
+        tileinfo.colsb[i] = 64;
+        tileinfo.rows[i] = 16;
+    }
+    AmxThreadContext::Current().LoadTileConfig(tileinfo);
+}
+
+// tile 0/1 为常驻的 A/B, 6 个 C tile 的乘加互不依赖, 足以掩盖 TMUL 的延迟
+template <AmxDotOp OP>
+TARGET_AMX void TmulLoop(const void *operands, int64_t iterations) {
+    LoadFullTileConfig();
+    TileLoad<0>(operands, 64);
+    TileLoad<1>(static_cast<const char *>(operands) + 1024, 64);
+    Unroll<6>([](auto c) { TileZero<2 + decltype(c)::value>(); });
+    for (int64_t i = 0; i < iterations; ++i) {
+        Unroll<6>([](auto c) { TileDot<OP, 2 + decltype(c)::value, 0, 1>(); });
+    }
+}
+
+// 依次把 tiles 个连续的 1KB tile 加载到 8 个 tile 寄存器中, 重复 iterations 遍
+TARGET_AMX inline void TileLoadLoop(const char *data, size_t tiles, int64_t iterations) {
+    LoadFullTileConfig();
+    for (int64_t i = 0; i < iterations; ++i) {
+        for (size_t t = 0; t + 8 <= tiles; t += 8) {
+            Unroll<8>([&](auto u) {
+                constexpr int U = decltype(u)::value;
+                TileLoad<U>(data + (t + U) * 1024, 64);
+            });
+        }
+    }
+}
+
+// 四路独立的异或累加, 每次读一个缓存行
+TARGET_AVX512 inline uint64_t StreamReadAvx512(const char *data, size_t bytes) {
+    __m512i s0 = _mm512_setzero_si512(), s1 = s0, s2 = s0, s3 = s0;
+    for (size_t i = 0; i + 256 <= bytes; i += 256) {
+        s0 = _mm512_xor_si512(s0, _mm512_load_si512(data + i));
+        s1 = _mm512_xor_si512(s1, _mm512_load_si512(data + i + 64));
+        s2 = _mm512_xor_si512(s2, _mm512_load_si512(data + i + 128));
+        s3 = _mm512_xor_si512(s3, _mm512_load_si512(data + i + 192));
+    }
+    const __m512i s = _mm512_xor_si512(_mm512_xor_si512(s0, s1), _mm512_xor_si512(s2, s3));
+    return _mm_cvtsi128_si64(_mm512_castsi512_si128(s));
+}
+
+inline uint64_t StreamRead(const char *data, size_t bytes) {
+    if (GetCpuFeatures().avx512f) return StreamReadAvx512(data, bytes);
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (size_t i = 0; i + 32 <= bytes; i += 32) {
+        uint64_t v[4];
+        std::memcpy(v, data + i, sizeof(v));
+        s0 ^= v[0];
+        s1 ^= v[1];
+        s2 ^= v[2];
+        s3 ^= v[3];
+    }
+    return s0 ^ s1 ^ s2 ^ s3;
+}
+
+// 在 pool 的每个线程上 (pool 为空时在当前线程) 同时执行 body(线程编号, iterations),
+// iterations 从 1 开始加倍到一次不短于 20ms, 返回之后 5 次中最短一次的秒数
+inline double TimeOnThreads(WorkerPool *pool, const std::function<void(int, int64_t)> &body,
+                            int64_t &iterations) {
+    auto once = [&](int64_t n) {
+        const auto t0 = std::chrono::steady_clock::now();
+        if (pool) {
+            pool->Run(pool->Size(), [&](int task, int) { body(task, n); });
+        } else {
+            body(0, n);
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(t1 - t0).count();
+    };
+    iterations = 1;
+    while (iterations < (int64_t(1) << 40) && once(iterations) < 0.02) iterations *= 2;
+    double best = once(iterations);
+    for (int r = 1; r < 5; ++r) best = std::min(best, once(iterations));
+    return best;
+}
+
+}  // namespace roofline_detail
+
+// 用 pool 的全部线程 (pool 为空时单线程) 测量各项上限, 约需一两秒
+inline RooflineCeilings MeasureRooflineCeilings(WorkerPool *pool) {
+    using namespace roofline_detail;
+    RooflineCeilings ceilings;
+    const int threads = pool ? pool->Size() : 1;
+    ceilings.threads = threads;
+    const CpuFeatures &f = GetCpuFeatures();
+    const CacheInfo &cache = GetCacheInfo();
+    int64_t iterations = 0;
+
+    if (f.amx_tile && f.amx_int8 && RequestAmxPermission()) {
+        // 操作数为 1.0 ~ 2.0 的 bf16 (按 int8 解释同样有效), 避免非规格化数
+        alignas(64) uint16_t operands[1024];
+        for (int i = 0; i < 1024; ++i) operands[i] = static_cast<uint16_t>(0x3F80 | (i & 0x7F));
+
+        double seconds = TimeOnThreads(
+            pool, [&](int, int64_t n) { TmulLoop<AmxDotOp::DPBSSD>(operands, n); }, iterations);
+        ceilings.int8_gops = double(iterations) * threads * 6 * (16 * 16 * 64 * 2) / seconds / 1e9;
+        if (f.amx_bf16) {
+            seconds = TimeOnThreads(
+                pool, [&](int, int64_t n) { TmulLoop<AmxDotOp::DPBF16PS>(operands, n); },
+                iterations);
+            ceilings.bf16_gflops =
+                double(iterations) * threads * 6 * (16 * 16 * 32 * 2) / seconds / 1e9;
+        }
+
+        // 每个线程一块各自的缓冲区, 分别取 L1D 和 L2 容量的一半
+        auto tile_bandwidth = [&](size_t bytes) {
+            const size_t tiles = std::max<size_t>(8, bytes / 1024 / 8 * 8);
+            AlignedBuffer buffer(tiles * 1024 * threads, false);
+            std::memset(buffer.Data(), 1, tiles * 1024 * threads);
+            const char *data = static_cast<const char *>(buffer.Data());
+            const double s = TimeOnThreads(
+                pool, [&](int t, int64_t n) { TileLoadLoop(data + t * tiles * 1024, tiles, n); },
+                iterations);
+            return double(iterations) * threads * tiles * 1024 / s / 1e9;
+        };
+        ceilings.l1_tile_gbps = tile_bandwidth(cache.l1d / 2);
+        ceilings.l2_tile_gbps = tile_bandwidth(cache.l2 / 2);
+    }
+
+    // LLC 的两倍, 至少 64MB, 至多 1GB; 每个线程读自己的一段, 由该线程首次写入
+    const size_t total = std::min(size_t(1) << 30, std::max(size_t(64) << 20, 2 * cache.llc));
+    const size_t slice = total / threads / 256 * 256;
+    AlignedBuffer buffer(slice * threads);
+    char *data = static_cast<char *>(buffer.Data());
+    auto touch = [&](int t, int) { std::memset(data + t * slice, 1, slice); };
+    if (pool) {
+        pool->Run(threads, touch);
+    } else {
+        touch(0, 0);
+    }
+    std::atomic<uint64_t> sink{0};  // 让读取的结果有用处, 避免被优化掉
+    const double seconds = TimeOnThreads(
+        pool,
+        [&](int t, int64_t n) {
+            uint64_t s = 0;
+            for (int64_t i = 0; i < n; ++i) s ^= StreamRead(data + t * slice, slice);
+            sink.fetch_xor(s, std::memory_order_relaxed);
+        },
+        iterations);
+    ceilings.memory_gbps = double(iterations) * threads * slice / seconds / 1e9;
+    return ceilings;
+}
+
+// 一次运行在屋顶线上的位置, 各项上限的单位为 GOPS, 不适用时为 0
+struct RooflinePoint {
+    double tile_intensity = 0;    // ops / tile 字节, 没有 tile 流量 (非 AMX 后端) 时为 0
+    double memory_intensity = 0;  // ops / 最少字节
+    double tmul_gops = 0;
+    double tile_gops = 0;
+    double memory_gops = 0;
+    const char *tile_level = "";  // tile 层使用的带宽: "l1" 或 "l2"
+    double roof_gops = 0;         // 以上各项中最低的一个
+    const char *bound = "-";      // 该上限的名字: tmul / tile / memory
+    double fraction = 0;          // 实测 GOPS / roof_gops
+};
+
+// ops 为一次调用的运算数, min_bytes 为一次调用至少读写的字节数 (多线程时为所有线程之和)。
+// tile 层按每个线程的工作集能否放进 L1D 选择 L1 或 L2 的带宽; 工作集放得进 LLC 时
+// 连续的调用不会访问内存, 内存带宽不构成上限
+inline RooflinePoint LocateOnRoofline(double ops, const TileTraffic &traffic, int64_t min_bytes,
+                                      bool bf16, const RooflineCeilings &c, double gops) {
+    const CacheInfo &cache = GetCacheInfo();
+    RooflinePoint p;
+    auto consider = [&](const char *name, double roof) {
+        if (roof > 0 && (p.roof_gops == 0 || roof < p.roof_gops)) {
+            p.roof_gops = roof;
+            p.bound = name;
+        }
+    };
+    p.memory_intensity = ops / min_bytes;
+    if (traffic.dots > 0) {
+        const bool in_l1 = size_t(min_bytes / c.threads) <= cache.l1d;
+        p.tile_intensity = ops / traffic.Bytes();
+        p.tmul_gops = bf16 ? c.bf16_gflops : c.int8_gops;
+        p.tile_level = in_l1 ? "l1" : "l2";
+        p.tile_gops = p.tile_intensity * (in_l1 ? c.l1_tile_gbps : c.l2_tile_gbps);
+        consider("tmul", p.tmul_gops);
+        consider("tile", p.tile_gops);
+    }
+    if (size_t(min_bytes) > cache.llc) {
+        p.memory_gops = p.memory_intensity * c.memory_gbps;
+        consider("memory", p.memory_gops);
+    }
+    if (p.roof_gops > 0) p.fraction = gops / p.roof_gops;
+    return p;
+}
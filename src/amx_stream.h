@@ -0,0 +1,289 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "amx_gemm.h"
+#include "amx_memory.h"
+#include "amx_pack.h"
+#include "amx_thread_pool.h"
+
+// 单个 I/O 线程按提交顺序执行读写任务。Submit 返回任务的序号, Wait(t) 等到第 t 个任务
+// (及之前的所有任务) 完成; 任一任务失败后其余任务不再执行, Wait 返回 false
+class IoQueue {
+   private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::deque<std::function<bool()>> jobs;
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    bool failed = false;
+    bool stop = false;
+    std::thread thread;  // 最后构造: 线程启动时其它成员都已初始化
+
+    void Loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stop || !jobs.empty(); });
+            if (jobs.empty()) return;
+            std::function<bool()> job = std::move(jobs.front());
+            jobs.pop_front();
+            const bool skip = failed;
+            lock.unlock();
+            const bool ok = skip || job();
+            lock.lock();
+            failed |= !ok;
+            ++completed;
+            done.notify_all();
+        }
+    }
+
+   public:
+    IoQueue() : thread(&IoQueue::Loop, this) {}
+
+    IoQueue(const IoQueue &) = delete;
+    IoQueue &operator=(const IoQueue &) = delete;
+
+    // 等待已提交的任务全部完成后退出
+    ~IoQueue() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    uint64_t Submit(std::function<bool()> job) {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+        wake.notify_one();
+        return ++submitted;
+    }
+
+    bool Wait(uint64_t ticket) {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return completed >= ticket; });
+        return !failed;
+    }
+
+    bool WaitAll() { return Wait(submitted); }
+};
+
+// 读满 / 写满 bytes 个字节, 处理 pread/pwrite 的部分完成和 EINTR
+inline bool PreadFull(int fd, void *dst, size_t bytes, uint64_t offset) {
+    auto *p = static_cast<char *>(dst);
+    while (bytes > 0) {
+        const ssize_t n = pread(fd, p, bytes, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n, bytes -= static_cast<size_t>(n), offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+inline bool PwriteFull(int fd, const void *src, size_t bytes, uint64_t offset) {
+    const auto *p = static_cast<const char *>(src);
+    while (bytes > 0) {
+        const ssize_t n = pwrite(fd, p, bytes, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n, bytes -= static_cast<size_t>(n), offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+struct StreamGemmOptions {
+    int panel_rows = 0;       // 每块的行数, 0 为自动 (见 StreamGemm)
+    bool mmap_input = false;  // true: mmap A 的文件直接计算; false: pread 到两个缓冲区
+    uint64_t a_offset = 0;    // A 在文件中的起始字节 (如跳过文件头)
+
+    static constexpr size_t PANEL_BYTES = size_t(64) << 20;  // 自动分块时 A、C 一块的目标大小
+};
+
+struct StreamGemmStats {
+    int panels = 0;
+    int panel_rows = 0;
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    double compute_us = 0;  // 计算所用的时间
+    double stall_us = 0;    // 计算线程等待 I/O 的时间, 理想情况下只有第一块的读取
+};
+
+// 流式 GEMM: A (M x K, 行主序, 行跨度 K) 存放在文件 a_path 中, 可以远大于内存。
+// A 按 panel_rows 行一块读入, C = A * B 按同样的块依次写入文件 c_path (M x N, 行主序)。
+// I/O 线程读取下一块、写回上一块的同时, 计算线程 (及线程池) 计算当前块:
+//   pread 方式: A、C 各两个缓冲区交替使用; 读完的范围用 POSIX_FADV_DONTNEED 从页缓存中
+//               丢弃, 大数据集不会挤掉其它数据;
+//   mmap 方式:  A 整个映射为只读 (MADV_SEQUENTIAL), I/O 线程逐页访问下一块使其常驻,
+//               计算直接读取映射; 用完的块用 MADV_DONTNEED 解除映射。
+// 自动选择时块的行数取 32 的倍数, 每块都由完整的宏块组成。失败时返回 false, 原因写入 error
+template <typename InputType, typename OutputType, typename WeightType>
+bool StreamGemm(IntelAmxMatrixMultiply<InputType, OutputType, WeightType> &multiply, int M,
+                const std::string &a_path, const PackedB<WeightType> &B,
+                const std::string &c_path, const StreamGemmOptions &options = {},
+                WorkerPool *pool = nullptr, StreamGemmStats *stats = nullptr,
+                std::string *error = nullptr) {
+    const int K = B.K(), N = B.N();
+    const size_t a_row = static_cast<size_t>(K) * sizeof(InputType);
+    const size_t c_row = static_cast<size_t>(N) * sizeof(OutputType);
+    int rows = options.panel_rows;
+    if (rows <= 0) {
+        // A、C 的一块合计约 PANEL_BYTES, 但至少分成 8 块, 否则读写无法与计算重叠
+        const size_t by_bytes = StreamGemmOptions::PANEL_BYTES / (a_row + c_row);
+        const size_t by_count = (static_cast<size_t>(M) + 7) / 8;
+        rows = static_cast<int>(std::min(by_bytes, by_count + 31) / 32 * 32);
+        rows = std::max(32, rows);
+    }
+    rows = std::min(rows, std::max(M, 1));
+    const int panels = (M + rows - 1) / rows;
+    auto fail = [&](const std::string &message) {
+        if (error != nullptr) *error = message;
+        return false;
+    };
+
+    const int a_fd = open(a_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (a_fd < 0) return fail("无法打开 " + a_path);
+    const uint64_t a_end = options.a_offset + static_cast<uint64_t>(M) * a_row;
+    struct stat st;
+    if (fstat(a_fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < a_end) {
+        close(a_fd);
+        return fail(a_path + " 比 M x K 的 A 短");
+    }
+    const int c_fd = open(c_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (c_fd < 0) {
+        close(a_fd);
+        return fail("无法创建 " + c_path);
+    }
+    // C 先扩展到完整大小, 各块按偏移写入
+    if (ftruncate(c_fd, static_cast<off_t>(static_cast<uint64_t>(M) * c_row)) != 0) {
+        close(a_fd);
+        close(c_fd);
+        return fail("无法扩展 " + c_path);
+    }
+
+    // mmap 方式: 映射覆盖 [页边界, a_end), A 的起始地址不必页对齐
+    const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    char *mapping = nullptr;
+    size_t map_bytes = 0;
+    uint64_t map_base = 0;
+    if (options.mmap_input && M > 0) {
+        map_base = options.a_offset / page * page;
+        map_bytes = static_cast<size_t>(a_end - map_base);
+        void *p = mmap(nullptr, map_bytes, PROT_READ, MAP_PRIVATE, a_fd,
+                       static_cast<off_t>(map_base));
+        if (p == MAP_FAILED) {
+            close(a_fd);
+            close(c_fd);
+            return fail("无法映射 " + a_path);
+        }
+        mapping = static_cast<char *>(p);
+        madvise(mapping, map_bytes, MADV_SEQUENTIAL);
+    } else {
+        posix_fadvise(a_fd, static_cast<off_t>(options.a_offset), 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    AlignedBuffer a_buffers[2], c_buffers[2];
+    for (int s = 0; s < 2 && panels > 0; ++s) {
+        if (mapping == nullptr) a_buffers[s] = AlignedBuffer(rows * a_row);
+        c_buffers[s] = AlignedBuffer(rows * c_row);
+    }
+    auto panel_rows = [&](int p) { return std::min(rows, M - p * rows); };
+    auto panel_offset = [&](int p) {
+        return options.a_offset + static_cast<uint64_t>(p) * rows * a_row;
+    };
+    auto mapped_panel = [&](int p) { return mapping + (panel_offset(p) - map_base); };
+
+    // 用完的块解除映射 (只读的私有映射, 页缓存中的数据不受影响); 与下一块共用的页保留
+    auto release_panel = [&](int p) {
+        const uint64_t begin = (panel_offset(p) - map_base) / page * page;
+        const uint64_t end = (panel_offset(p) + panel_rows(p) * a_row - map_base) / page * page;
+        if (end > begin) madvise(mapping + begin, end - begin, MADV_DONTNEED);
+    };
+
+    // 第 p 块的读取: pread 到缓冲区, 或逐页访问映射 (缺页由 I/O 线程承担)
+    auto read_panel = [&](int p) {
+        return [&, p]() {
+            const size_t bytes = panel_rows(p) * a_row;
+            if (mapping != nullptr) {
+                const char *src = mapped_panel(p);
+                volatile char sink = 0;
+                for (size_t b = 0; b < bytes; b += page) sink = sink + src[b];
+                if (bytes > 0) sink = sink + src[bytes - 1];
+                return true;
+            }
+            if (!PreadFull(a_fd, a_buffers[p % 2].Data(), bytes, panel_offset(p))) return false;
+            posix_fadvise(a_fd, static_cast<off_t>(panel_offset(p)), static_cast<off_t>(bytes),
+                          POSIX_FADV_DONTNEED);
+            return true;
+        };
+    };
+    auto write_panel = [&](int p) {
+        return [&, p]() {
+            const uint64_t offset = static_cast<uint64_t>(p) * rows * c_row;
+            return PwriteFull(c_fd, c_buffers[p % 2].Data(), panel_rows(p) * c_row, offset);
+        };
+    };
+
+    StreamGemmStats local;
+    local.panel_rows = rows;
+    bool ok = true;
+    {
+        IoQueue io;
+        std::vector<uint64_t> read_done(panels), write_done(panels);
+        if (panels > 0) read_done[0] = io.Submit(read_panel(0));
+        for (int p = 0; p < panels; ++p) {
+            const auto t0 = std::chrono::steady_clock::now();
+            // 当前块已读入, 且两块之前使用同一个 C 缓冲区的写回已完成
+            ok = io.Wait(read_done[p]) && (p < 2 || io.Wait(write_done[p - 2]));
+            if (!ok) break;
+            if (p + 1 < panels) read_done[p + 1] = io.Submit(read_panel(p + 1));
+            const auto t1 = std::chrono::steady_clock::now();
+
+            const auto *a = mapping != nullptr
+                                ? reinterpret_cast<const InputType *>(mapped_panel(p))
+                                : static_cast<const InputType *>(a_buffers[p % 2].Data());
+            auto *c = static_cast<OutputType *>(c_buffers[p % 2].Data());
+            if (pool != nullptr) {
+                multiply.Gemm(panel_rows(p), a, K, B, c, N, *pool);
+            } else {
+                multiply.Gemm(panel_rows(p), a, K, B, c, N);
+            }
+            write_done[p] = io.Submit(write_panel(p));
+            if (mapping != nullptr) release_panel(p);
+            const auto t2 = std::chrono::steady_clock::now();
+            local.stall_us += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            local.compute_us += std::chrono::duration<double, std::micro>(t2 - t1).count();
+            local.bytes_read += panel_rows(p) * a_row;
+            local.bytes_written += panel_rows(p) * c_row;
+            ++local.panels;
+        }
+        const auto t0 = std::chrono::steady_clock::now();
+        ok = io.WaitAll() && ok;
+        local.stall_us += std::chrono::duration<double, std::micro>(
+                              std::chrono::steady_clock::now() - t0)
+                              .count();
+    }
+    if (mapping != nullptr) munmap(mapping, map_bytes);
+    close(a_fd);
+    ok = close(c_fd) == 0 && ok;
+    if (stats != nullptr) *stats = local;
+    return ok || fail("读写 " + a_path + " / " + c_path + " 失败");
+}
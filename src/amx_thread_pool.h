@@ -0,0 +1,170 @@
+#pragma once
+
+#include <immintrin.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 常驻的工作线程池: 线程在构造时创建并绑定到固定的 CPU, 在多次 Run 之间保持存活,
+// 因此每个线程的 AMX 权限和 tile 配置 (AmxThreadContext) 只需初始化一次。
+// 任务结束后线程先自旋等待一小段时间再休眠, 连续的 GEMM 调用不必经过线程唤醒。
+//
+// 任务按编号连续地分给各线程 (相邻的任务通常共享 A 或 B, 利于缓存复用),
+// 线程做完自己的部分后再从其它线程的剩余任务中窃取
+class WorkerPool {
+   private:
+    static constexpr int SPIN_ITERATIONS = 1 << 14;
+
+    // 每个线程的任务区间 [next, end), 独占一个缓存行避免伪共享
+    struct alignas(64) TaskRange {
+        std::atomic<int> next{0};
+        int end = 0;
+    };
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::mutex run_mutex;  // 串行化来自不同线程的 Run 调用
+
+    std::atomic<uint64_t> generation{0};
+    std::vector<TaskRange> ranges;
+    std::atomic<int> pending{0};
+    const std::function<void(int, int)> *job = nullptr;
+    bool stop = false;
+
+    // 当前线程所在的线程池和编号 (不是工作线程时 pool 为空), 用来识别任务中嵌套的 Run
+    struct WorkerIdentity {
+        const WorkerPool *pool = nullptr;
+        int worker = 0;
+    };
+
+    static WorkerIdentity &CurrentWorker() {
+        static thread_local WorkerIdentity identity;
+        return identity;
+    }
+
+    static std::vector<int> AllowedCpus() {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+            }
+        }
+        if (cpus.empty()) cpus.push_back(0);
+        return cpus;
+    }
+
+    void WorkerLoop(int worker) {
+        CurrentWorker() = {this, worker};
+        uint64_t seen = 0;
+        while (true) {
+            uint64_t gen = generation.load(std::memory_order_acquire);
+            for (int spin = 0; gen == seen && spin < SPIN_ITERATIONS; ++spin) {
+                _mm_pause();
+                gen = generation.load(std::memory_order_acquire);
+            }
+            if (gen == seen) {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stop || generation.load() != seen; });
+                if (stop) return;
+                gen = generation.load();
+            }
+            seen = gen;
+
+            // 先做自己的任务, 再依次从其它线程窃取
+            const int count = Size();
+            for (int v = 0; v < count; ++v) {
+                TaskRange &range = ranges[(worker + v) % count];
+                for (int task = range.next.fetch_add(1); task < range.end;
+                     task = range.next.fetch_add(1)) {
+                    (*job)(task, worker);
+                }
+            }
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_one();
+            }
+        }
+    }
+
+   public:
+    // thread_count <= 0 时使用当前进程可用的全部 CPU
+    explicit WorkerPool(int thread_count = 0, bool pin = true) {
+        std::vector<int> cpus = AllowedCpus();
+        if (thread_count <= 0) thread_count = static_cast<int>(cpus.size());
+        ranges = std::vector<TaskRange>(thread_count);
+        threads.reserve(thread_count);
+        for (int t = 0; t < thread_count; ++t) {
+            threads.emplace_back(&WorkerPool::WorkerLoop, this, t);
+            if (pin) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpus[t % cpus.size()], &set);
+                pthread_setaffinity_np(threads.back().native_handle(), sizeof(set), &set);
+            }
+        }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto &t : threads) t.join();
+    }
+
+    int Size() const { return static_cast<int>(threads.size()); }
+
+    // 在工作线程上执行 fn(task, worker), task 取 [0, tasks), worker 为执行线程的编号;
+    // 所有任务完成后返回。在本线程池的任务中再次调用 Run (如任务回调中调用
+    // Gemm(..., pool)) 时, 外层的 Run 仍持有 run_mutex, 而且要等的工作线程就包括本线程,
+    // 派发下去会死锁; 这时直接在当前线程上依次执行全部任务, worker 为当前线程的编号
+    void Run(int tasks, const std::function<void(int, int)> &fn) {
+        if (tasks <= 0) return;
+        const WorkerIdentity &self = CurrentWorker();
+        if (self.pool == this) {
+            for (int task = 0; task < tasks; ++task) fn(task, self.worker);
+            return;
+        }
+        std::lock_guard<std::mutex> run_lock(run_mutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            const int count = Size();
+            for (int w = 0; w < count; ++w) {
+                ranges[w].next.store(static_cast<int>(static_cast<int64_t>(tasks) * w / count));
+                ranges[w].end = static_cast<int>(static_cast<int64_t>(tasks) * (w + 1) / count);
+            }
+            pending.store(count);
+            generation.fetch_add(1, std::memory_order_release);
+        }
+        wake.notify_all();
+
+        for (int spin = 0; pending.load(std::memory_order_acquire) != 0 && spin < SPIN_ITERATIONS;
+             ++spin) {
+            _mm_pause();
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return pending.load() == 0; });
+    }
+
+    // 进程级共享的默认线程池, 第一次使用时创建
+    static WorkerPool &Default() {
+        static WorkerPool pool;
+        return pool;
+    }
+};
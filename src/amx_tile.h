@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+// AMX 的乘加指令: dpb[s|u][s|u]d 的两个字母依次为 A、B 的符号 (s 有符号, u 无符号)
+enum class AmxDotOp { DPBSSD, DPBSUD, DPBUSD, DPBUUD, DPBF16PS };
+
+// _tile_loadd 等内建宏把 tile 编号字符串化后拼进汇编, 编号只能是字面量。
+// 这里用 "i" 约束把模板参数作为立即数传给汇编 (%c 输出不带 $ 的常数), tile 编号因此可以在
+// 编译期计算; 指令格式与 GCC 的 amxtileintrin.h 相同, 同时给出 AT&T 和 Intel 两种语法
+// 汇编读取从 base 开始的内存: "m" 输入 (大小未知的 char 数组) 告诉编译器这里读内存,
+// 之前只由 tile 读取的写入 (如补零的临时缓冲区) 不会被当作死存储消除, 也不会被移到加载之后。
+// 不用 "memory" clobber, 否则编译器要在每次加载前后把寄存器中的值写回、重新读取
+template <int TILE>
+inline void TileLoad(const void *base, size_t stride) {
+    asm volatile("{tileloadd\t(%0,%1,1), %%tmm%c2|tileloadd\t%%tmm%c2, [%0+%1*1]}"
+                 :
+                 : "r"(base), "r"(static_cast<long>(stride)), "i"(TILE),
+                   "m"(*static_cast<const char(*)[]>(base)));
+}
+
+template <int TILE>
+inline void TileStore(void *base, size_t stride) {
+    asm volatile("{tilestored\t%%tmm%c2, (%0,%1,1)|tilestored\t[%0+%1*1], %%tmm%c2}"
+                 :
+                 : "r"(base), "r"(static_cast<long>(stride)), "i"(TILE)
+                 : "memory");
+}
+
+template <int TILE>
+inline void TileZero() {
+    asm volatile("tilezero\t%%tmm%c0" : : "i"(TILE));
+}
+
+#define AMX_TILE_DOT_ASM(name)                                                              \
+    asm volatile("{" name "\t%%tmm%c2, %%tmm%c1, %%tmm%c0|" name "\t%%tmm%c0, %%tmm%c1, %%tmm%c2}" \
+                 :                                                                          \
+                 : "i"(DST), "i"(SRC1), "i"(SRC2))
+
+// DST += SRC1 * SRC2, SRC1 为 A, SRC2 为 VNNI 格式的 B
+template <AmxDotOp OP, int DST, int SRC1, int SRC2>
+inline void TileDot() {
+    if constexpr (OP == AmxDotOp::DPBF16PS) {
+        AMX_TILE_DOT_ASM("tdpbf16ps");
+    } else if constexpr (OP == AmxDotOp::DPBUSD) {
+        AMX_TILE_DOT_ASM("tdpbusd");
+    } else if constexpr (OP == AmxDotOp::DPBSUD) {
+        AMX_TILE_DOT_ASM("tdpbsud");
+    } else if constexpr (OP == AmxDotOp::DPBUUD) {
+        AMX_TILE_DOT_ASM("tdpbuud");
+    } else {
+        AMX_TILE_DOT_ASM("tdpbssd");
+    }
+}
+
+#undef AMX_TILE_DOT_ASM
+
+// 编译期展开的循环: f(std::integral_constant<int, 0>) ... f(std::integral_constant<int, N - 1>)
+template <typename F, int... I>
+inline void UnrollImpl(F &&f, std::integer_sequence<int, I...>) {
+    (f(std::integral_constant<int, I>{}), ...);
+}
+
+template <int N, typename F>
+inline void Unroll(F &&f) {
+    UnrollImpl(f, std::make_integer_sequence<int, N>{});
+}
+
+// MR x NR 个 tile 的寄存器分块 (MR 个 A tile、NR 个 B tile、MR * NR 个 C tile) 的编号分配。
+// 8 个 tile 放得下时 A/B 各自常驻; 放不下时 (1x4、4x1 等) 较长的一侧轮流使用剩余的 tile,
+// 这一侧每个 tile 在一次 K 步中只使用一次, 轮换不会多出加载
+template <int MR, int NR>
+struct TileBlock {
+    static constexpr int C_TILES = MR * NR;
+    static constexpr int FREE = 8 - C_TILES;
+    static constexpr bool RESIDENT = MR + NR <= FREE;
+    static constexpr int A_BUFS = RESIDENT || MR <= NR ? MR : FREE - NR;
+    static constexpr int B_BUFS = RESIDENT || MR > NR ? NR : FREE - MR;
+
+    static_assert(MR >= 1 && NR >= 1 && A_BUFS >= 1 && B_BUFS >= 1 &&
+                      C_TILES + A_BUFS + B_BUFS <= 8,
+                  "the block does not fit in 8 tiles");
+    static_assert(RESIDENT || MR == 1 || NR == 1, "only 1xN / Nx1 blocks may stream an operand");
+
+    static constexpr int A(int i) { return i % A_BUFS; }
+    static constexpr int B(int j) { return A_BUFS + j % B_BUFS; }
+    static constexpr int C(int i, int j) { return A_BUFS + B_BUFS + i * NR + j; }
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "amx_context.h"
+#include "amx_cpu.h"
+#include "amx_matrix.h"
+
+// 教程第1~3版的内核, 由 matrix_mul_amx_with_policy_v1~v3.cpp 和 amx_bench 共用, 基准测试
+// 计时的就是教程中的代码。调用前须申请 AMX 权限并加载 LoadTutorialConfig 的配置。
+// 第4/5版的内核是 IntelAmxMatrixMultiply 的两个 MatrixMultiply 接口 (amx_gemm.h)
+
+constexpr int TILE_ROWS = 16;
+constexpr int TILE_COLSB = 64;
+
+// 第1~5版使用的统一 tile 配置: 8 个 tile 都是 16 行 x 64 字节
+TARGET_AMX inline void LoadTutorialConfig() {
+    __tile_config tileinfo{};
+    tileinfo.palette_id = 1;
+    for (int i = 0; i < 8; ++i) {
+        tileinfo.colsb[i] = TILE_COLSB;
+        tileinfo.rows[i] = TILE_ROWS;
+    }
+    AmxThreadContext::Current().LoadTileConfig(tileinfo);
+}
+
+// 第1版: 一个 A tile 乘一个 B tile, C += A * B, 只用到 3 个 tile
+TARGET_AMX inline void MatrixMultiplyV1(const Matrix<int8_t> &A, const Matrix<int8_t> &B,
+                                        Matrix<int32_t> &C) {
+    _tile_loadd(2, A.Data(), A.Stride());
+    _tile_loadd(3, B.Data(), B.Stride());
+    _tile_loadd(1, C.Data(), C.Stride());
+
+    _tile_dpbssd(1, 2, 3);
+    _tile_stored(1, C.Data(), C.Stride());
+}
+
+// 第2版: 2x2 分块, 8 个 tile 全部用上, A0/A1/B0/B1 各参与两次乘加
+TARGET_AMX inline void MatrixMultiplyV2(const Matrix<int8_t> &A0, const Matrix<int8_t> &A1,
+                                        const Matrix<int8_t> &B0, const Matrix<int8_t> &B1,
+                                        Matrix<int32_t> &C00, Matrix<int32_t> &C01,
+                                        Matrix<int32_t> &C10, Matrix<int32_t> &C11) {
+    _tile_loadd(0, A0.Data(), A0.Stride());
+    _tile_loadd(1, B0.Data(), B0.Stride());
+
+    _tile_loadd(2, A1.Data(), A1.Stride());
+    _tile_loadd(3, B1.Data(), B1.Stride());
+
+    _tile_loadd(4, C00.Data(), C00.Stride());
+    _tile_loadd(5, C01.Data(), C01.Stride());
+    _tile_loadd(6, C10.Data(), C10.Stride());
+    _tile_loadd(7, C11.Data(), C11.Stride());
+
+    _tile_dpbssd(4, 0, 1);
+    _tile_stored(4, C00.Data(), C00.Stride());
+
+    _tile_dpbssd(5, 0, 3);
+    _tile_stored(5, C01.Data(), C01.Stride());
+
+    _tile_dpbssd(6, 2, 1);
+    _tile_stored(6, C10.Data(), C10.Stride());
+
+    _tile_dpbssd(7, 2, 3);
+    _tile_stored(7, C11.Data(), C11.Stride());
+}
+
+// 第3版: 1x1 分块, C 留在 tile 中沿 K 累加 VA[i] * VB[i]
+TARGET_AMX inline void MatrixMultiplyV3(const std::vector<Matrix<int8_t>> &VA,
+                                        const std::vector<Matrix<int8_t>> &VB,
+                                        Matrix<int32_t> &C) {
+    _tile_loadd(0, C.Data(), C.Stride());
+    for (size_t i = 0; i < VA.size(); i++) {
+        _tile_loadd(1, VA[i].Data(), VA[i].Stride());
+        _tile_loadd(2, VB[i].Data(), VB[i].Stride());
+        _tile_dpbssd(0, 1, 2);
+    }
+    _tile_stored(0, C.Data(), C.Stride());
+}
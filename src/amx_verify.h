@@ -0,0 +1,1191 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "amx_gemm.h"
+#include "amx_quantize.h"
+#include "amx_stream.h"
+#include "amx_thread_pool.h"
+#include "amx_weight_file.h"
+
+// 随机正确性验证: 在随机形状、混有极值的随机数据上运行每个后端的各个入口 (原始 VNNI B、
+// PackedB、单线程/线程池、各寄存器分块、融合后处理、零点补偿、批量与分组), 与标量参考实现比较。
+// 整数结果须逐位一致; bf16 的参考值以双精度计算, 误差不得超过 fp32 累加 K 次的舍入误差界
+// (K + 2) * 2^-24 * sum|a * b|。C 的行跨度带有填充, 填充部分预先写入哨兵值, 越界写出也会被发现
+
+constexpr uint8_t VERIFY_SENTINEL = 0x5A;
+
+// 随机元素, 约 1/4 取各类型的极值: int8 的 -128/127、uint8 的 0/255 等覆盖符号扩展与
+// 累加的边界; bf16 取 0、±1、±2^10、±2^-10 和尾数全 1 的值 (不含非规格化数, AMX 会把它们当作 0)
+template <typename DataType>
+inline DataType RandomElement(std::mt19937 &rng) {
+    const uint32_t r = rng();
+    if constexpr (std::is_same_v<DataType, bfloat16>) {
+        static const float EXTREMES[] = {0.0f,        -0.0f,        1.0f,       -1.0f,
+                                         1024.0f,     -1024.0f,     1.0f / 1024, -1.0f / 1024,
+                                         1.9921875f,  -1.9921875f};
+        if (r % 4 == 0) return bfloat16(EXTREMES[(r >> 2) % 10]);
+        return bfloat16(static_cast<float>(r >> 8) / (1 << 23) - 1.0f);
+    } else if constexpr (std::is_signed_v<DataType>) {
+        static const int EXTREMES[] = {-128, 127, -1, 0};
+        if (r % 4 == 0) return static_cast<DataType>(EXTREMES[(r >> 2) % 4]);
+        return static_cast<DataType>(r >> 8);
+    } else {
+        static const int EXTREMES[] = {0, 255, 128, 127};
+        if (r % 4 == 0) return static_cast<DataType>(EXTREMES[(r >> 2) % 4]);
+        return static_cast<DataType>(r >> 8);
+    }
+}
+
+template <typename InputType, typename WeightType>
+inline const char *VerifyTypeName() {
+    if constexpr (std::is_same_v<InputType, bfloat16>) {
+        return "bf16";
+    } else if constexpr (std::is_signed_v<InputType>) {
+        return std::is_signed_v<WeightType> ? "s8s8" : "s8u8";
+    } else {
+        return std::is_signed_v<WeightType> ? "u8s8" : "u8u8";
+    }
+}
+
+// 行主序 K x N 的 B 转为 VNNI 格式: (K + G - 1) / G 行, 行跨度 ldv (元素个数), K 尾部补 0
+template <typename DataType>
+inline std::vector<DataType> ToVnni(int K, int N, const DataType *B, int ldb, int ldv) {
+    constexpr int G = VNNI_GROUP<DataType>;
+    const int rows = (K + G - 1) / G;
+    std::vector<DataType> vnni(static_cast<size_t>(rows) * ldv);
+    for (int r = 0; r < rows; ++r) {
+        for (int j = 0; j < N; ++j) {
+            for (int g = 0; g < G; ++g) {
+                const int k = r * G + g;
+                vnni[static_cast<size_t>(r) * ldv + j * G + g] =
+                    k < K ? B[static_cast<size_t>(k) * ldb + j] : DataType{};
+            }
+        }
+    }
+    return vnni;
+}
+
+// 一个随机问题: A 为 M x K (行跨度 lda, 为 0 时随机填充 0~8 个元素), B 为行主序 K x N,
+// ref/tol 为参考结果及允许误差
+template <typename InputType, typename WeightType>
+struct VerifyProblem {
+    int M = 0, N = 0, K = 0, lda = 0;
+    std::vector<InputType> A;
+    std::vector<WeightType> B;
+    std::vector<double> ref;
+    std::vector<double> tol;
+
+    VerifyProblem(int m, int n, int k, std::mt19937 &rng, int ld = 0) : M(m), N(n), K(k) {
+        lda = ld > 0 ? ld : K + static_cast<int>(rng() % 9);
+        A.resize(static_cast<size_t>(M) * lda);
+        B.resize(static_cast<size_t>(K) * N);
+        for (auto &a : A) a = RandomElement<InputType>(rng);
+        for (auto &b : B) b = RandomElement<WeightType>(rng);
+        Reference();
+    }
+
+    // 整数以 int64 精确累加; bf16 以双精度累加, 同时累加 |a * b| 得到误差界
+    void Reference() {
+        ref.assign(static_cast<size_t>(M) * N, 0.0);
+        tol.assign(static_cast<size_t>(M) * N, 0.0);
+        for (int i = 0; i < M; ++i) {
+            for (int j = 0; j < N; ++j) {
+                int64_t isum = 0;
+                double sum = 0, abs_sum = 0;
+                for (int k = 0; k < K; ++k) {
+                    const InputType a = A[static_cast<size_t>(i) * lda + k];
+                    const WeightType b = B[static_cast<size_t>(k) * N + j];
+                    if constexpr (std::is_integral_v<InputType>) {
+                        isum += int64_t(a) * int64_t(b);
+                    } else {
+                        sum += double(float(a)) * double(float(b));
+                        abs_sum += std::fabs(double(float(a)) * double(float(b)));
+                    }
+                }
+                const size_t idx = static_cast<size_t>(i) * N + j;
+                if constexpr (std::is_integral_v<InputType>) {
+                    ref[idx] = static_cast<double>(isum);
+                } else {
+                    ref[idx] = sum;
+                    tol[idx] = (K + 2) * std::ldexp(abs_sum, -24) + K * double(FLT_MIN);
+                }
+            }
+        }
+    }
+
+    // (A - za) * (B - zb), 按 int32 回绕, 零点补偿的参考值直接由定义计算
+    std::vector<int32_t> Compensated(int32_t za, int32_t zb) const {
+        std::vector<int32_t> out(static_cast<size_t>(M) * N);
+        for (int i = 0; i < M; ++i) {
+            for (int j = 0; j < N; ++j) {
+                uint32_t sum = 0;
+                for (int k = 0; k < K; ++k) {
+                    const int64_t a = int64_t(A[static_cast<size_t>(i) * lda + k]) - za;
+                    const int64_t b = int64_t(B[static_cast<size_t>(k) * N + j]) - zb;
+                    sum += static_cast<uint32_t>(a * b);
+                }
+                out[static_cast<size_t>(i) * N + j] = static_cast<int32_t>(sum);
+            }
+        }
+        return out;
+    }
+};
+
+// 带填充和哨兵的输出矩阵: rows x ld 个元素, 每行前 cols 个为有效部分
+template <typename DataType>
+struct VerifyOutput {
+    int rows, cols, ld;
+    std::vector<DataType> data;
+
+    VerifyOutput(int r, int c, int stride) : rows(r), cols(c), ld(stride) {
+        data.resize(static_cast<size_t>(rows) * ld);
+        std::memset(static_cast<void *>(data.data()), VERIFY_SENTINEL,
+                    data.size() * sizeof(DataType));
+    }
+
+    DataType *Data() { return data.data(); }
+    DataType At(int i, int j) const { return data[static_cast<size_t>(i) * ld + j]; }
+
+    bool PaddingIntact() const {
+        for (int i = 0; i < rows; ++i) {
+            const auto *p = reinterpret_cast<const uint8_t *>(&data[static_cast<size_t>(i) * ld]);
+            for (size_t b = cols * sizeof(DataType); b < ld * sizeof(DataType); ++b) {
+                if (p[b] != VERIFY_SENTINEL) return false;
+            }
+        }
+        return true;
+    }
+};
+
+// 后处理的参考值: 零点补偿由 Compensated 给出 (整数精确), 缩放、偏置和激活以双精度计算
+inline double EpilogueReference(const GemmEpilogue &ep, double acc, int i, int j) {
+    const double row_scale = ep.row_scales != nullptr ? ep.row_scales[i] : 1.0;
+    double y = acc * row_scale * (ep.scales != nullptr ? ep.scales[j] : ep.scale);
+    if (ep.bias != nullptr) y += ep.bias[j];
+    switch (ep.activation) {
+        case EpilogueActivation::RELU:
+            return std::max(y, 0.0);
+        case EpilogueActivation::GELU:
+            return y / (1.0 + std::exp(-2.0 * 0.7978845608 * (y + 0.044715 * y * y * y)));
+        case EpilogueActivation::CLAMP:
+            return std::min(std::max(y, double(ep.clamp_min)), double(ep.clamp_max));
+        default:
+            return y;
+    }
+}
+
+class GemmVerifier {
+   private:
+    struct Section {
+        std::string name;
+        int checks = 0;
+        int failures = 0;
+    };
+
+    std::mt19937 rng;
+    int cases;
+    WorkerPool *pool;
+    std::ostream &log;
+    int total_checks = 0;
+    int total_failures = 0;
+    int reported = 0;  // 已打印详情的失败个数
+    Section section;
+
+    static constexpr int MAX_REPORTED = 20;
+
+    void Begin(const std::string &name) { section = Section{name}; }
+
+    void End() {
+        log << (section.failures == 0 ? "[通过] " : "[失败] ") << section.name << ": "
+            << section.checks << " 项";
+        if (section.failures != 0) log << ", 失败 " << section.failures << " 项";
+        log << std::endl;  // 及时输出, 后面的检查崩溃时也能看到已通过的部分
+        total_checks += section.checks;
+        total_failures += section.failures;
+    }
+
+    void Check(bool ok, const std::string &what, const std::string &detail) {
+        ++section.checks;
+        if (ok) return;
+        ++section.failures;
+        if (reported++ < MAX_REPORTED) {
+            log << "  " << section.name << " " << what << ": " << detail << "\n";
+        }
+    }
+
+    static std::string ShapeName(int M, int N, int K) {
+        return std::to_string(M) + "x" + std::to_string(N) + "x" + std::to_string(K);
+    }
+
+    // 形状: 先是固定的边界形状 (不足一个 tile、恰好整 tile、整 tile 多 1), 其后随机;
+    // 每 4 个随机形状中有一个较大的, K 跨过 KC 分块
+    void NextShape(int c, int &M, int &N, int &K) {
+        static const int FIXED[][3] = {{1, 1, 1},   {16, 16, 64}, {32, 32, 64},
+                                       {17, 33, 65}, {15, 47, 3},  {64, 64, 256}};
+        constexpr int FIXED_COUNT = sizeof(FIXED) / sizeof(FIXED[0]);
+        if (c < FIXED_COUNT) {
+            M = FIXED[c][0], N = FIXED[c][1], K = FIXED[c][2];
+        } else if (c % 4 == 0) {
+            M = 1 + rng() % 160, N = 1 + rng() % 160;
+            K = GetGemmBlocking().kc + 1 + rng() % 300;
+        } else {
+            M = 1 + rng() % 80, N = 1 + rng() % 80, K = 1 + rng() % 300;
+        }
+    }
+
+    template <typename OutputType, typename InputType, typename WeightType>
+    void CompareAcc(const VerifyProblem<InputType, WeightType> &p,
+                    const VerifyOutput<OutputType> &C, const std::string &what) {
+        int64_t bad = 0;
+        std::ostringstream first;
+        for (int i = 0; i < p.M; ++i) {
+            for (int j = 0; j < p.N; ++j) {
+                const size_t idx = static_cast<size_t>(i) * p.N + j;
+                const double got = static_cast<double>(C.At(i, j));
+                if (std::fabs(got - p.ref[idx]) <= p.tol[idx]) continue;
+                if (bad++ == 0) {
+                    first << "(" << i << ", " << j << ") = " << got << ", 应为 " << p.ref[idx];
+                    if (p.tol[idx] > 0) first << " ± " << p.tol[idx];
+                }
+            }
+        }
+        std::ostringstream detail;
+        if (bad != 0) detail << bad << " 个元素不一致, 第一个 " << first.str();
+        if (!C.PaddingIntact()) detail << (bad != 0 ? "; " : "") << "写到了行跨度的填充部分";
+        Check(detail.str().empty(), ShapeName(p.M, p.N, p.K) + " " + what, detail.str());
+    }
+
+    // 随机的后处理参数, 缩放使结果大致落在 ±100, int8/uint8 输出会饱和一部分
+    template <typename InputType, typename WeightType>
+    GemmEpilogue RandomEpilogue(const VerifyProblem<InputType, WeightType> &p,
+                                std::vector<float> &bias, std::vector<float> &scales,
+                                std::vector<float> &row_scales) {
+        GemmEpilogue ep;
+        const float acc_scale = std::is_integral_v<InputType> ? 5000.0f : 1.0f;
+        const float base = 100.0f / (std::sqrt(float(p.K)) * acc_scale);
+        ep.scale = base;
+        std::uniform_real_distribution<float> unit(0.5f, 1.5f), shift(-50.0f, 50.0f);
+        if (rng() % 2) {
+            scales.resize(p.N);
+            for (float &s : scales) s = base * unit(rng);
+            ep.scales = scales.data();
+        }
+        if (rng() % 2) {
+            row_scales.resize(p.M);
+            for (float &s : row_scales) s = unit(rng);
+            ep.row_scales = row_scales.data();
+        }
+        if (rng() % 2) {
+            bias.resize(p.N);
+            for (float &b : bias) b = shift(rng);
+            ep.bias = bias.data();
+        }
+        ep.activation = static_cast<EpilogueActivation>(rng() % 4);
+        ep.clamp_min = -20.0f, ep.clamp_max = 60.0f;
+        if constexpr (std::is_integral_v<InputType>) {
+            ep.output = static_cast<EpilogueOutput>(rng() % 5);
+        } else {
+            ep.output = static_cast<EpilogueOutput>(rng() % 4);
+        }
+        if (ep.output == EpilogueOutput::INT8) ep.zero_point = static_cast<int>(rng() % 41) - 20;
+        if (ep.output == EpilogueOutput::UINT8) ep.zero_point = static_cast<int>(rng() % 256);
+        return ep;
+    }
+
+    // acc 为补偿后的参考累加值, acc_tol 为其误差界; 浮点输出允许 fp32 运算的舍入误差,
+    // 量化输出允许参考值附近误差范围内的两种舍入结果
+    static bool EpilogueMatches(const GemmEpilogue &ep, const void *dst, int i, int j, double acc,
+                                double acc_tol, bool int_acc) {
+        const size_t idx = static_cast<size_t>(i) * ep.ldd + j;
+        if (ep.output == EpilogueOutput::INT32 && int_acc) {
+            return static_cast<const int32_t *>(dst)[idx] == static_cast<int32_t>(acc);
+        }
+        const double s = (ep.row_scales != nullptr ? ep.row_scales[i] : 1.0) *
+                         (ep.scales != nullptr ? ep.scales[j] : ep.scale);
+        const double y = EpilogueReference(ep, acc, i, j);
+        const double b = ep.bias != nullptr ? std::fabs(ep.bias[j]) : 0.0;
+        const double tol = 1.2 * acc_tol * std::fabs(s) +
+                           16 * FLT_EPSILON * (std::fabs(acc * s) + b + std::fabs(y)) + 1e-30;
+        auto quantized = [&](int64_t lo, int64_t hi, int64_t got) {
+            auto q = [&](double v) {
+                return std::clamp<int64_t>(int64_t(std::nearbyint(v)) + ep.zero_point, lo, hi);
+            };
+            return got >= q(y - tol) && got <= q(y + tol);
+        };
+        switch (ep.output) {
+            case EpilogueOutput::FP32:
+                return std::fabs(static_cast<const float *>(dst)[idx] - y) <= tol;
+            case EpilogueOutput::BF16: {
+                const float got = Bf16BitsToFloat(static_cast<const uint16_t *>(dst)[idx]);
+                return std::fabs(got - y) <= tol + std::ldexp(std::fabs(y), -8);
+            }
+            case EpilogueOutput::INT8:
+                return quantized(-128, 127, static_cast<const int8_t *>(dst)[idx]);
+            case EpilogueOutput::UINT8:
+                return quantized(0, 255, static_cast<const uint8_t *>(dst)[idx]);
+            default:
+                return quantized(INT32_MIN, 2147483520, static_cast<const int32_t *>(dst)[idx]);
+        }
+    }
+
+    template <typename InputType, typename WeightType>
+    void CompareEpilogue(const VerifyProblem<InputType, WeightType> &p, const GemmEpilogue &ep,
+                         const std::vector<int32_t> &compensated, const std::vector<uint8_t> &dst,
+                         const std::string &what) {
+        int64_t bad = 0;
+        std::ostringstream detail;
+        for (int i = 0; i < p.M; ++i) {
+            for (int j = 0; j < p.N; ++j) {
+                const size_t idx = static_cast<size_t>(i) * p.N + j;
+                const double acc = compensated.empty() ? p.ref[idx] : compensated[idx];
+                if (EpilogueMatches(ep, dst.data(), i, j, acc, p.tol[idx],
+                                    std::is_integral_v<InputType>)) {
+                    continue;
+                }
+                if (bad++ == 0) detail << "(" << i << ", " << j << ") 不一致";
+            }
+        }
+        const size_t row = static_cast<size_t>(ep.ldd) * ep.ElementSize();
+        bool padding_intact = true;
+        for (int i = 0; i < p.M; ++i) {
+            for (size_t b = p.N * ep.ElementSize(); b < row; ++b) {
+                padding_intact &= dst[i * row + b] == VERIFY_SENTINEL;
+            }
+        }
+        if (!padding_intact) detail << (bad++ == 0 ? "" : "; ") << "写到了行跨度的填充部分";
+        if (bad != 0) detail << ", 共 " << bad << " 处";
+        std::ostringstream name;
+        name << ShapeName(p.M, p.N, p.K) << " " << what << " (输出 " << int(ep.output)
+             << ", 激活 " << int(ep.activation) << ")";
+        Check(bad == 0, name.str(), detail.str());
+    }
+
+    // 按名字强制后端; 该后端在本机不可用时返回 false
+    template <typename Multiply>
+    static bool CreateWithBackend(GemmBackend backend, Multiply &multiply) {
+        const char *saved = std::getenv("AMX_GEMM_BACKEND");
+        const std::string previous = saved != nullptr ? saved : "";
+        setenv("AMX_GEMM_BACKEND", GemmBackendName(backend), 1);
+        multiply = Multiply::Create();
+        if (saved != nullptr) {
+            setenv("AMX_GEMM_BACKEND", previous.c_str(), 1);
+        } else {
+            unsetenv("AMX_GEMM_BACKEND");
+        }
+        return multiply.Backend() == backend;
+    }
+
+    // 一个问题在所有入口上的结果: 原始 VNNI B / PackedB, 单线程 / 线程池, AMX 的每种分块
+    template <typename InputType, typename OutputType, typename WeightType, typename Multiply>
+    void VerifyDrivers(Multiply &multiply, const VerifyProblem<InputType, WeightType> &p) {
+        constexpr int G = VNNI_GROUP<WeightType>;
+        const int ldv = p.N * G + G * static_cast<int>(rng() % 3);
+        const std::vector<WeightType> vnni = ToVnni(p.K, p.N, p.B.data(), p.N, ldv);
+        const PackedB<WeightType> packed(p.K, p.N, p.B.data(), p.N);
+        const Matrix<InputType> a_tiles = ToMatrix(p.M, p.K, p.A.data(), p.lda,
+                                                   MatrixLayout::TILE_MAJOR);
+
+        // AMX 后端的每种分块都关闭 GEMV, 小 M 的问题也覆盖 AMX 内核; 最后再把 GEMV 的阈值设为
+        // 无穷大, 任意 M 都走 GEMV 内核 (kernel 为 {-1, -1})
+        std::vector<GemmKernelShape> kernels{{0, 0}};
+        const int default_gemv = multiply.GemvMaxM();
+        if (multiply.Backend() == GemmBackend::AMX) {
+            kernels.insert(kernels.end(), std::begin(GEMM_KERNELS), std::end(GEMM_KERNELS));
+            if (default_gemv > 0) kernels.push_back({-1, -1});
+        }
+        static const int PREFETCH[] = {PREFETCH_AUTO, 0, 1, 3};
+        for (const GemmKernelShape &kernel : kernels) {
+            const bool gemv = kernel.mr < 0;
+            multiply.SetKernel(gemv ? GemmKernelShape{0, 0} : kernel);
+            if (multiply.Backend() == GemmBackend::AMX) {
+                multiply.SetGemvMaxM(gemv ? INT_MAX : 0);
+            }
+            multiply.SetPrefetchDistance(PREFETCH[rng() % 4]);
+            const std::string k = gemv            ? "gemv"
+                                  : kernel.mr == 0 ? "auto"
+                                                   : std::to_string(kernel.mr) + "x" +
+                                                         std::to_string(kernel.nr);
+            for (int threaded = 0; threaded < (pool ? 2 : 1); ++threaded) {
+                const std::string t = threaded ? ", 线程池" + RandomSplitK(multiply) : "";
+                VerifyOutput<OutputType> C(p.M, p.N, p.N + rng() % 5);
+                if (threaded) {
+                    multiply.Gemm(p.M, p.N, p.K, p.A.data(), p.lda, vnni.data(), ldv, C.Data(),
+                                  C.ld, *pool);
+                } else {
+                    multiply.Gemm(p.M, p.N, p.K, p.A.data(), p.lda, vnni.data(), ldv, C.Data(),
+                                  C.ld);
+                }
+                CompareAcc(p, C, "VNNI B, 分块 " + k + t);
+
+                VerifyOutput<OutputType> D(p.M, p.N, p.N + rng() % 5);
+                if (threaded) {
+                    multiply.Gemm(p.M, p.A.data(), p.lda, packed, D.Data(), D.ld, *pool);
+                } else {
+                    multiply.Gemm(p.M, p.A.data(), p.lda, packed, D.Data(), D.ld);
+                }
+                CompareAcc(p, D, "PackedB, 分块 " + k + t);
+
+                VerifyOutput<OutputType> E(p.M, p.N, p.N + rng() % 5);
+                if (threaded) {
+                    multiply.Gemm(a_tiles, packed, E.Data(), E.ld, *pool);
+                } else {
+                    multiply.Gemm(a_tiles, packed, E.Data(), E.ld);
+                }
+                CompareAcc(p, E, "tile 主序 A, 分块 " + k + t);
+            }
+        }
+        multiply.SetKernel({0, 0});
+        multiply.SetPrefetchDistance(PREFETCH_AUTO);
+        multiply.SetSplitK(0);
+        multiply.SetGemvMaxM(default_gemv);
+
+        // C 也为 Matrix 的版本: tile 主序的 A 须走 ATiles 的路径, 不能被当作行主序的视图
+        Matrix<OutputType> F(p.M, p.N);
+        multiply.Gemm(a_tiles, packed, F);
+        VerifyOutput<OutputType> out(p.M, p.N, p.N);
+        std::memcpy(static_cast<void *>(out.Data()), F.Data(), F.Bytes());
+        CompareAcc(p, out, "tile 主序 A, C 为 Matrix");
+    }
+
+    template <typename DataType>
+    static Matrix<DataType> ToMatrix(int rows, int cols, const DataType *src, int ld,
+                                     MatrixLayout layout) {
+        Matrix<DataType> m(rows, cols, layout);
+        for (int i = 0; i < rows; ++i) {
+            for (int j = 0; j < cols; ++j) m.At(i, j) = src[static_cast<size_t>(i) * ld + j];
+        }
+        return m;
+    }
+
+    // 布局转换: 行主序 -> tile 主序 -> 行主序应还原出原矩阵, tile 主序的补齐部分为 0;
+    // 由 tile 主序的 B 打包出的 PackedB (含列和) 应与行主序的 B 逐字节相同
+    template <typename InputType, typename WeightType>
+    void VerifyLayout(const VerifyProblem<InputType, WeightType> &p) {
+        const Matrix<InputType> a = ToMatrix(p.M, p.K, p.A.data(), p.lda, MatrixLayout::ROW_MAJOR);
+        const Matrix<InputType> tiles = ConvertLayout(a, MatrixLayout::TILE_MAJOR);
+        const Matrix<InputType> back = ConvertLayout(tiles, MatrixLayout::ROW_MAJOR);
+        int64_t bad = 0, padding = 0;
+        for (int i = 0; i < p.M; ++i) {
+            for (int k = 0; k < p.K; ++k) {
+                bad += !SameBits(tiles.At(i, k), a.At(i, k)) ||
+                       !SameBits(back.At(i, k), a.At(i, k));
+            }
+        }
+        const auto *bytes = reinterpret_cast<const uint8_t *>(tiles.Data());
+        const int tile_cols = 64 / sizeof(InputType);
+        for (size_t b = 0; b < tiles.Bytes(); ++b) {
+            const size_t tile = b / MATRIX_TILE_BYTES, row = b % MATRIX_TILE_BYTES / 64;
+            const int i = static_cast<int>(tile / tiles.ColTiles() * 16 + row);
+            const int k = static_cast<int>(tile % tiles.ColTiles() * tile_cols +
+                                           b % 64 / sizeof(InputType));
+            padding += (i >= p.M || k >= p.K) && bytes[b] != 0;
+        }
+        std::ostringstream detail;
+        if (bad != 0) detail << bad << " 个元素不一致";
+        if (padding != 0) detail << (bad != 0 ? "; " : "") << padding << " 个补齐字节不为 0";
+        Check(detail.str().empty(), ShapeName(p.M, 0, p.K) + " A 行主序 <-> tile 主序",
+              detail.str());
+
+        const PackedB<WeightType> want(p.K, p.N, p.B.data(), p.N);
+        const PackedB<WeightType> got(
+            ToMatrix(p.K, p.N, p.B.data(), p.N, MatrixLayout::TILE_MAJOR));
+        bool same = std::memcmp(got.Data(), want.Data(), want.Bytes()) == 0;
+        if constexpr (std::is_integral_v<WeightType>) {
+            same &= std::equal(got.ColumnSums(), got.ColumnSums() + p.N, want.ColumnSums());
+        }
+        Check(same, ShapeName(0, p.N, p.K) + " tile 主序 B 打包", "与行主序 B 的打包结果不同");
+    }
+
+    template <typename DataType>
+    static bool SameBits(DataType a, DataType b) {
+        return std::memcmp(&a, &b, sizeof(DataType)) == 0;
+    }
+
+    // 线程池上的调用一半按形状自动决定是否按 K 切分, 一半强制切成 2~5 片; 返回用于描述的后缀
+    template <typename Multiply>
+    std::string RandomSplitK(Multiply &multiply) {
+        const int splits = rng() % 2 ? 0 : 2 + static_cast<int>(rng() % 4);
+        multiply.SetSplitK(splits);
+        return splits ? ", K 切分 " + std::to_string(splits) : "";
+    }
+
+    // 融合后处理: 随机的输出类型、激活、偏置和缩放; 整数 GEMM 同时随机设置 A/B 的零点
+    template <typename InputType, typename OutputType, typename WeightType, typename Multiply>
+    void VerifyEpilogue(Multiply &multiply, const VerifyProblem<InputType, WeightType> &p,
+                        bool threaded) {
+        const PackedB<WeightType> packed(p.K, p.N, p.B.data(), p.N);
+        std::vector<float> bias, scales, row_scales;
+        GemmEpilogue ep = RandomEpilogue(p, bias, scales, row_scales);
+        std::vector<int32_t> row_sums, compensated;
+        if constexpr (std::is_integral_v<InputType>) {
+            if (rng() % 2) ep.a_zero_point = static_cast<int32_t>(rng() % 256);
+            if (rng() % 2) {
+                ep.b_zero_point = static_cast<int32_t>(rng() % 256) - 128;
+                row_sums.resize(p.M);
+                RowSums(p.M, p.K, p.A.data(), p.lda, row_sums.data());
+                ep.row_sums = row_sums.data();
+            }
+            compensated = p.Compensated(ep.a_zero_point, ep.b_zero_point);
+        }
+        ep.ldd = p.N + static_cast<int>(rng() % 5);
+        std::vector<uint8_t> dst(static_cast<size_t>(p.M) * ep.ldd * ep.ElementSize(),
+                                 VERIFY_SENTINEL);
+        ep.dst = dst.data();
+
+        VerifyOutput<OutputType> C(p.M, p.N, p.N + rng() % 5);
+        std::string name = "后处理";
+        if (threaded) {
+            name += ", 线程池" + RandomSplitK(multiply);
+            multiply.Gemm(p.M, p.A.data(), p.lda, packed, C.Data(), C.ld, ep, *pool);
+            multiply.SetSplitK(0);
+        } else {
+            multiply.Gemm(p.M, p.A.data(), p.lda, packed, C.Data(), C.ld, ep);
+        }
+        CompareEpilogue(p, ep, compensated, dst, name);
+    }
+
+    // 缩放很大时 y 远超出 int32 的范围, 整数输出须饱和到类型的边界。直接调用标量和 AVX-512
+    // 两种后处理, 累加结果为 int32 和 fp32 (bf16 GEMM) 两种
+    template <typename AccType>
+    void VerifySaturation() {
+        const int M = 1 + static_cast<int>(rng() % 8), N = 1 + static_cast<int>(rng() % 40);
+        std::uniform_int_distribution<int> acc_dist(-100000, 100000);
+        std::uniform_real_distribution<float> unit(0.5f, 1.5f);
+        std::vector<AccType> C(static_cast<size_t>(M) * N);
+        for (AccType &c : C) c = static_cast<AccType>(acc_dist(rng));
+        std::vector<float> scales(N);
+        for (float &s : scales) s = 1e7f * unit(rng);
+        for (EpilogueOutput output :
+             {EpilogueOutput::INT8, EpilogueOutput::UINT8, EpilogueOutput::INT32}) {
+            // int32 累加的 int32 输出直接写出 acc, 不经过缩放
+            if (output == EpilogueOutput::INT32 && std::is_integral_v<AccType>) continue;
+            GemmEpilogue ep;
+            ep.scales = scales.data();
+            ep.output = output;
+            if (output == EpilogueOutput::INT8) ep.zero_point = static_cast<int>(rng() % 41) - 20;
+            if (output == EpilogueOutput::UINT8) ep.zero_point = static_cast<int>(rng() % 256);
+            ep.ldd = N;
+            std::vector<uint8_t> dst(static_cast<size_t>(M) * N * ep.ElementSize());
+            ep.dst = dst.data();
+            for (bool avx512 : {false, true}) {
+                if (avx512 && !GetCpuFeatures().avx512bw) continue;
+                if (avx512) {
+                    ApplyEpilogueAvx512(M, N, C.data(), N, ep);
+                } else {
+                    ApplyEpilogueScalar(M, N, C.data(), N, ep);
+                }
+                int bad = 0;
+                for (int i = 0; i < M; ++i) {
+                    for (int j = 0; j < N; ++j) {
+                        const double acc = C[static_cast<size_t>(i) * N + j];
+                        bad += !EpilogueMatches(ep, dst.data(), i, j, acc, 0.0,
+                                                std::is_integral_v<AccType>);
+                    }
+                }
+                std::ostringstream name;
+                name << ShapeName(M, N, 0) << (avx512 ? " AVX-512" : " 标量") << " (输出 "
+                     << int(output) << ")";
+                Check(bad == 0, name.str(), std::to_string(bad) + " 个元素没有饱和");
+            }
+        }
+    }
+
+    // fp32 -> bf16 的 NaN: 尾数只在低 16 位或低位全为 1 的 NaN 舍入后不能变成 Inf 或翻转
+    // 符号位。检查 FloatToBf16Bits 以及标量和 AVX-512 后处理的 bf16 输出
+    void VerifyBf16NaN() {
+        static const uint32_t PATTERNS[] = {0x7F800001u, 0xFF800001u, 0x7FBFFFFFu, 0x7FFFFFFFu,
+                                            0xFFFFFFFFu, 0x7FC00000u, 0x7F80FFFFu, 0xFF80FFFFu};
+        constexpr int N = static_cast<int>(std::size(PATTERNS));
+        auto is_nan = [](uint16_t b, uint32_t from) {
+            return (b & 0x7FFF) > 0x7F80 && (b >> 15) == (from >> 31);
+        };
+        std::vector<float> acc(N);
+        int bad = 0;
+        for (int j = 0; j < N; ++j) {
+            std::memcpy(&acc[j], &PATTERNS[j], sizeof(float));
+            bad += !is_nan(FloatToBf16Bits(acc[j]), PATTERNS[j]);
+        }
+        Check(bad == 0, "FloatToBf16Bits", std::to_string(bad) + " 个 NaN 没有保持为 NaN");
+
+        GemmEpilogue ep;
+        ep.output = EpilogueOutput::BF16;
+        ep.ldd = N;
+        std::vector<uint16_t> dst(N);
+        ep.dst = dst.data();
+        for (bool avx512 : {false, true}) {
+            if (avx512 && !GetCpuFeatures().avx512bw) continue;
+            if (avx512) {
+                ApplyEpilogueAvx512(1, N, acc.data(), N, ep);
+            } else {
+                ApplyEpilogueScalar(1, N, acc.data(), N, ep);
+            }
+            bad = 0;
+            for (int j = 0; j < N; ++j) bad += !is_nan(dst[j], PATTERNS[j]);
+            Check(bad == 0, avx512 ? "AVX-512 后处理" : "标量后处理",
+                  std::to_string(bad) + " 个 NaN 没有保持为 NaN");
+        }
+    }
+
+    // 在线程池的任务中再调用同一个线程池的 Gemm: 嵌套的 Run 在当前工作线程上执行, 不能死锁。
+    // 结果先全部算完, 再在调用线程上比较 (Check 不是线程安全的)
+    void VerifyNestedRun() {
+        using Multiply = IntelAmxMatrixMultiply<int8_t, int32_t>;
+        Multiply multiply = Multiply::Create();
+        const int tasks = pool->Size() + 1;
+        std::vector<VerifyProblem<int8_t, int8_t>> problems;
+        std::vector<PackedB<int8_t>> packed;
+        std::vector<VerifyOutput<int32_t>> outputs;
+        problems.reserve(tasks);
+        for (int t = 0; t < tasks; ++t) {
+            problems.emplace_back(1 + rng() % 80, 1 + rng() % 80, 1 + rng() % 300, rng);
+            const VerifyProblem<int8_t, int8_t> &p = problems.back();
+            packed.emplace_back(p.K, p.N, p.B.data(), p.N);
+            outputs.emplace_back(p.M, p.N, p.N + static_cast<int>(rng() % 5));
+        }
+        pool->Run(tasks, [&](int t, int) {
+            const VerifyProblem<int8_t, int8_t> &p = problems[t];
+            multiply.Gemm(p.M, p.A.data(), p.lda, packed[t], outputs[t].Data(), outputs[t].ld,
+                          *pool);
+        });
+        for (int t = 0; t < tasks; ++t) CompareAcc(problems[t], outputs[t], "嵌套在任务中的 Gemm");
+        multiply.TileRelease();
+    }
+
+    // A 的零点由库内部用 PackedB 的列和补偿, 结果原地写回 C
+    template <typename InputType, typename OutputType, typename WeightType, typename Multiply>
+    void VerifyZeroPoint(Multiply &multiply, const VerifyProblem<InputType, WeightType> &p,
+                         bool threaded) {
+        const PackedB<WeightType> packed(p.K, p.N, p.B.data(), p.N);
+        const int32_t za = static_cast<int32_t>(rng() % 256);
+        const std::vector<int32_t> want = p.Compensated(za, 0);
+        VerifyOutput<OutputType> C(p.M, p.N, p.N + rng() % 5);
+        if (threaded) {
+            multiply.Gemm(p.M, p.A.data(), p.lda, za, packed, C.Data(), C.ld, *pool);
+        } else {
+            multiply.Gemm(p.M, p.A.data(), p.lda, za, packed, C.Data(), C.ld);
+        }
+        int64_t bad = 0;
+        for (int i = 0; i < p.M; ++i) {
+            for (int j = 0; j < p.N; ++j) {
+                bad += C.At(i, j) != want[static_cast<size_t>(i) * p.N + j];
+            }
+        }
+        std::ostringstream detail;
+        if (bad != 0) detail << bad << " 个元素不一致";
+        if (!C.PaddingIntact()) detail << (bad != 0 ? "; " : "") << "写到了行跨度的填充部分";
+        Check(detail.str().empty(),
+              ShapeName(p.M, p.N, p.K) + " za=" + std::to_string(za) + (threaded ? ", 线程池" : ""),
+              detail.str());
+    }
+
+    // 批量与分组: 每个问题的结果分别与各自的参考值比较
+    template <typename InputType, typename OutputType, typename WeightType, typename Multiply>
+    void VerifyBatched(Multiply &multiply) {
+        using Problem = VerifyProblem<InputType, WeightType>;
+        constexpr int G = VNNI_GROUP<WeightType>;
+        const int M = 1 + rng() % 40, N = 1 + rng() % 80, K = 1 + rng() % 300;
+        const int batch = 1 + rng() % 24;
+        const bool shared_b = rng() % 4 == 0;
+        const int lda = K + rng() % 9, ldb = N * G, ldc = N + 3;
+        std::vector<Problem> problems;
+        for (int b = 0; b < batch; ++b) {
+            problems.emplace_back(M, N, K, rng, lda);
+            if (shared_b && b > 0) {
+                problems.back().B = problems.front().B;
+                problems.back().Reference();
+            }
+        }
+
+        // 跨度形式: 各问题依次排在同一块缓冲区中, 之间留有空隙
+        const size_t b_size = static_cast<size_t>((K + G - 1) / G) * ldb;
+        const size_t stride_a = static_cast<size_t>(M) * lda + 64;
+        const size_t stride_b = shared_b ? 0 : b_size + 32;
+        const size_t stride_c = static_cast<size_t>(M) * ldc + 16;
+        std::vector<InputType> A(stride_a * batch);
+        std::vector<WeightType> B(shared_b ? b_size : stride_b * batch);
+        std::vector<std::vector<WeightType>> vnni;
+        for (int b = 0; b < batch; ++b) {
+            const Problem &p = problems[b];
+            std::copy(p.A.begin(), p.A.end(), A.begin() + b * stride_a);
+            vnni.push_back(ToVnni(K, N, p.B.data(), N, ldb));
+            if (b == 0 || !shared_b) {
+                std::copy(vnni[b].begin(), vnni[b].end(), B.begin() + b * stride_b);
+            }
+        }
+        for (int threaded = 0; threaded < (pool ? 2 : 1); ++threaded) {
+            std::vector<OutputType> C(stride_c * batch);
+            if (threaded) {
+                multiply.GemmBatched(M, N, K, A.data(), lda, stride_a, B.data(), ldb, stride_b,
+                                     C.data(), ldc, stride_c, batch, *pool);
+            } else {
+                multiply.GemmBatched(M, N, K, A.data(), lda, stride_a, B.data(), ldb, stride_b,
+                                     C.data(), ldc, stride_c, batch);
+            }
+            int64_t bad = 0;
+            for (int b = 0; b < batch; ++b) {
+                const Problem &p = problems[b];
+                for (int i = 0; i < M; ++i) {
+                    for (int j = 0; j < N; ++j) {
+                        const size_t idx = static_cast<size_t>(i) * N + j;
+                        const double got = static_cast<double>(C[b * stride_c + i * ldc + j]);
+                        bad += !(std::fabs(got - p.ref[idx]) <= p.tol[idx]);
+                    }
+                }
+            }
+            std::ostringstream what;
+            what << ShapeName(M, N, K) << " x " << batch << (shared_b ? ", 共享 B" : "")
+                 << (threaded ? ", 线程池" : "");
+            Check(bad == 0, "GemmBatched " + what.str(), std::to_string(bad) + " 个元素不一致");
+
+            // 指针数组形式: 直接使用每个问题自己的缓冲区
+            std::vector<const InputType *> a_list;
+            std::vector<const WeightType *> b_list;
+            std::vector<VerifyOutput<OutputType>> outputs;
+            std::vector<OutputType *> c_list;
+            const int ldo = N + 1;
+            for (int b = 0; b < batch; ++b) {
+                a_list.push_back(problems[b].A.data());
+                b_list.push_back(vnni[b].data());
+                outputs.emplace_back(M, N, ldo);
+            }
+            for (auto &o : outputs) c_list.push_back(o.Data());
+            if (threaded) {
+                multiply.GemmBatched(M, N, K, a_list.data(), lda, b_list.data(), ldb,
+                                     c_list.data(), ldo, batch, *pool);
+            } else {
+                multiply.GemmBatched(M, N, K, a_list.data(), lda, b_list.data(), ldb,
+                                     c_list.data(), ldo, batch);
+            }
+            for (int b = 0; b < batch; ++b) {
+                CompareAcc(problems[b], outputs[b], "GemmBatched 指针数组" + what.str());
+            }
+        }
+    }
+
+    template <typename InputType, typename OutputType, typename WeightType, typename Multiply>
+    void VerifyGrouped(Multiply &multiply) {
+        using Problem = VerifyProblem<InputType, WeightType>;
+        using Group = typename Multiply::GemmGroup;
+        constexpr int G = VNNI_GROUP<WeightType>;
+        const int group_count = 1 + rng() % 4;
+        std::vector<std::vector<Problem>> problems(group_count);
+        std::vector<std::vector<std::vector<WeightType>>> vnni(group_count);
+        std::vector<std::vector<const InputType *>> a_list(group_count);
+        std::vector<std::vector<const WeightType *>> b_list(group_count);
+        std::vector<Group> groups;
+        for (int g = 0; g < group_count; ++g) {
+            const int M = 1 + rng() % 40, N = 1 + rng() % 80, K = 1 + rng() % 200;
+            const int count = 1 + rng() % 8, lda = K + rng() % 9;
+            for (int c = 0; c < count; ++c) {
+                problems[g].emplace_back(M, N, K, rng, lda);
+                vnni[g].push_back(ToVnni(K, N, problems[g].back().B.data(), N, N * G));
+            }
+            for (int c = 0; c < count; ++c) {
+                a_list[g].push_back(problems[g][c].A.data());
+                b_list[g].push_back(vnni[g][c].data());
+            }
+            groups.push_back(Group{M, N, K, a_list[g].data(), lda, b_list[g].data(), N * G,
+                                   nullptr, N + static_cast<int>(rng() % 5), count});
+        }
+        for (int threaded = 0; threaded < (pool ? 2 : 1); ++threaded) {
+            std::vector<std::vector<VerifyOutput<OutputType>>> outputs(group_count);
+            std::vector<std::vector<OutputType *>> c_list(group_count);
+            for (int g = 0; g < group_count; ++g) {
+                for (const Problem &p : problems[g]) {
+                    outputs[g].emplace_back(p.M, p.N, groups[g].ldc);
+                }
+                for (auto &o : outputs[g]) c_list[g].push_back(o.Data());
+                groups[g].C = c_list[g].data();
+            }
+            if (threaded) {
+                multiply.GemmGrouped(groups.data(), group_count, *pool);
+            } else {
+                multiply.GemmGrouped(groups.data(), group_count);
+            }
+            for (int g = 0; g < group_count; ++g) {
+                for (size_t c = 0; c < problems[g].size(); ++c) {
+                    CompareAcc(problems[g][c], outputs[g][c],
+                               std::string("GemmGrouped") + (threaded ? ", 线程池" : ""));
+                }
+            }
+        }
+    }
+
+    // QuantizedLinear: 参考值由标量代码独立量化 X 和 W 后按 double 计算; 量化结果应逐位相同,
+    // 输出只允许 fp32 反量化的舍入误差
+    void VerifyQuantizedLinear(bool threaded) {
+        const int M = 1 + rng() % 80, N = 1 + rng() % 80, K = 1 + rng() % 300;
+        const int ldx = K + rng() % 5, ldw = N + rng() % 5;
+        std::normal_distribution<float> normal(0.0f, 1.0f);
+        std::vector<float> X(static_cast<size_t>(M) * ldx), W(static_cast<size_t>(K) * ldw);
+        std::vector<float> bias(N);
+        for (float &x : X) x = normal(rng);
+        for (float &w : W) w = normal(rng) * 0.1f;
+        for (float &b : bias) b = normal(rng);
+        if (rng() % 4 == 0) std::fill(X.begin(), X.begin() + ldx, 0.0f);  // 全 0 的行
+        const auto granularity =
+            rng() % 2 ? QuantGranularity::PER_ROW : QuantGranularity::PER_TENSOR;
+        QuantizedLinear linear(K, N, W.data(), ldw, rng() % 2 ? bias.data() : nullptr,
+                               granularity);
+        linear.SetActivation(static_cast<EpilogueActivation>(rng() % 3));
+
+        GemmEpilogue ep;
+        ep.ldd = N + static_cast<int>(rng() % 5);
+        std::vector<float> Y(static_cast<size_t>(M) * ep.ldd);
+        if (threaded) {
+            linear.Forward(M, X.data(), ldx, Y.data(), ep.ldd, *pool);
+        } else {
+            linear.Forward(M, X.data(), ldx, Y.data(), ep.ldd);
+        }
+
+        std::vector<float> x_steps(M), w_steps(N), max_w(N, 0.0f);
+        std::vector<int8_t> qx(static_cast<size_t>(M) * K), qw(static_cast<size_t>(K) * N);
+        float max_x = 0.0f;
+        for (int i = 0; i < M; ++i) {
+            x_steps[i] = SymmetricStep(MaxAbsScalar(K, &X[static_cast<size_t>(i) * ldx]));
+            max_x = std::max(max_x, x_steps[i]);
+        }
+        if (granularity == QuantGranularity::PER_TENSOR) {
+            std::fill(x_steps.begin(), x_steps.end(), max_x);
+        }
+        for (int i = 0; i < M; ++i) {
+            QuantizeRowScalar(K, &X[static_cast<size_t>(i) * ldx], InverseStep(x_steps[i]),
+                              &qx[static_cast<size_t>(i) * K]);
+        }
+        for (int k = 0; k < K; ++k) {
+            for (int j = 0; j < N; ++j) max_w[j] = std::max(max_w[j], std::fabs(W[k * ldw + j]));
+        }
+        for (int j = 0; j < N; ++j) w_steps[j] = SymmetricStep(max_w[j]);
+        for (int k = 0; k < K; ++k) {
+            for (int j = 0; j < N; ++j) {
+                const float v = std::nearbyint(W[k * ldw + j] * InverseStep(w_steps[j]));
+                qw[k * N + j] = static_cast<int8_t>(std::clamp(v, -127.0f, 127.0f));
+            }
+        }
+
+        std::ostringstream name;
+        name << ShapeName(M, N, K)
+             << (granularity == QuantGranularity::PER_ROW ? " 每行" : " 每张量")
+             << (threaded ? ", 线程池" : "");
+        const bool steps_match =
+            std::equal(x_steps.begin(), x_steps.end(), linear.InputSteps()) &&
+            std::equal(w_steps.begin(), w_steps.end(), linear.WeightSteps());
+        Check(steps_match, name.str() + " 量化步长", "与标量量化的步长不同");
+
+        ep.row_scales = x_steps.data();
+        ep.scales = w_steps.data();
+        ep.bias = linear.Bias();
+        ep.activation = linear.Activation();
+        int64_t bad = 0;
+        for (int i = 0; i < M; ++i) {
+            for (int j = 0; j < N; ++j) {
+                int64_t acc = 0;
+                for (int k = 0; k < K; ++k) acc += int64_t(qx[i * K + k]) * qw[k * N + j];
+                bad += !EpilogueMatches(ep, Y.data(), i, j, double(acc), 0.0, false);
+            }
+        }
+        Check(bad == 0, name.str(), std::to_string(bad) + " 个元素不一致");
+    }
+
+    static std::string TempPath() {
+        char path[] = "/tmp/amx_verify_XXXXXX";
+        const int fd = mkstemp(path);
+        if (fd >= 0) close(fd);
+        return path;
+    }
+
+    // 权重文件: 写出再映射, 数据、列和与步长逐字节相同, 映射的 B 直接用于 Gemm;
+    // 损坏 (魔数错误、截断) 或类型不符的文件须被拒绝
+    template <typename InputType, typename OutputType, typename WeightType>
+    void VerifyWeightFile() {
+        using Multiply = IntelAmxMatrixMultiply<InputType, OutputType, WeightType>;
+        Multiply multiply = Multiply::Create();
+        const VerifyProblem<InputType, WeightType> p(1 + rng() % 80, 1 + rng() % 80,
+                                                     1 + rng() % 300, rng);
+        const PackedB<WeightType> packed(p.K, p.N, p.B.data(), p.N);
+        std::vector<float> scales(p.N);
+        for (float &s : scales) s = std::ldexp(float(rng() % 1000 + 1), -10);
+        const bool with_scales = rng() % 2;
+        const std::string path = TempPath(), name = ShapeName(0, p.N, p.K);
+        std::string error;
+        Check(SaveWeightFile(path, packed, with_scales ? scales.data() : nullptr, &error),
+              name + " 写出", error);
+
+        MappedWeights<WeightType> mapped;
+        if (!mapped.Open(path, &error, rng() % 2)) {
+            Check(false, name + " 映射", error);
+            unlink(path.c_str());
+            return;
+        }
+        const PackedB<WeightType> &b = mapped.Packed();
+        bool same = b.K() == p.K && b.N() == p.N && b.Bytes() == packed.Bytes() &&
+                    std::memcmp(b.Data(), packed.Data(), packed.Bytes()) == 0 &&
+                    reinterpret_cast<uintptr_t>(b.Data()) % 64 == 0;
+        if constexpr (std::is_integral_v<WeightType>) {
+            same &= std::equal(packed.ColumnSums(), packed.ColumnSums() + p.N, b.ColumnSums());
+        }
+        same &= with_scales ? std::equal(scales.begin(), scales.end(), mapped.Scales())
+                            : mapped.Scales() == nullptr;
+        Check(same, name + " 映射的内容", "与写出的 PackedB 不同");
+        for (int threaded = 0; threaded < (pool ? 2 : 1); ++threaded) {
+            VerifyOutput<OutputType> C(p.M, p.N, p.N + rng() % 5);
+            if (threaded) {
+                multiply.Gemm(p.M, p.A.data(), p.lda, b, C.Data(), C.ld, *pool);
+            } else {
+                multiply.Gemm(p.M, p.A.data(), p.lda, b, C.Data(), C.ld);
+            }
+            CompareAcc(p, C, std::string("映射的 B") + (threaded ? ", 线程池" : ""));
+        }
+
+        // 损坏的文件: 截断 1 字节; 改写魔数; 按另一种权重类型打开
+        auto rejected = [&](const std::string &what) {
+            MappedWeights<WeightType> bad;
+            Check(!bad.Open(path, &error), name + " " + what, "没有被拒绝");
+            Check(!bad.IsOpen() && bad.K() == 0 && bad.N() == 0, name + " " + what + "后的状态",
+                  "仍保留被拒绝文件的形状");
+        };
+        const off_t bytes = static_cast<off_t>(mapped.Header().file_bytes);
+        mapped.Close();
+        using OtherType = std::conditional_t<std::is_same_v<WeightType, int8_t>, uint8_t, int8_t>;
+        MappedWeights<OtherType> other;
+        Check(!other.Open(path, &error), name + " 类型不符", "没有被拒绝");
+        // 文件头中的 K 接近 INT32_MAX: 计算 tile 数时不能溢出, 须被拒绝; 检查后改回原值
+        auto write_k = [&](int32_t k) {
+            std::FILE *f = std::fopen(path.c_str(), "r+b");
+            if (f == nullptr) return false;
+            const bool ok = std::fseek(f, offsetof(WeightFileHeader, k), SEEK_SET) == 0 &&
+                            std::fwrite(&k, sizeof(k), 1, f) == 1;
+            return std::fclose(f) == 0 && ok;
+        };
+        if (write_k(INT32_MAX)) rejected("K 过大");
+        write_k(p.K);
+        if (truncate(path.c_str(), bytes - 1) == 0) rejected("截断");
+        if (std::FILE *f = std::fopen(path.c_str(), "r+b")) {
+            std::fputc('X', f);
+            std::fclose(f);
+            rejected("魔数错误");
+        }
+        unlink(path.c_str());
+        multiply.TileRelease();
+    }
+
+    // 流式 GEMM: A 写入文件 (前面随机留出文件头), 以 pread 和 mmap 两种方式分块计算,
+    // 块的行数随机 (含不是 16 倍数的), 读回 C 的文件与参考值比较; A 的文件过短时须报错
+    template <typename InputType, typename OutputType, typename WeightType>
+    void VerifyStream() {
+        using Multiply = IntelAmxMatrixMultiply<InputType, OutputType, WeightType>;
+        Multiply multiply = Multiply::Create();
+        const int K = 1 + rng() % 300;
+        const VerifyProblem<InputType, WeightType> p(1 + rng() % 200, 1 + rng() % 80, K, rng, K);
+        const PackedB<WeightType> packed(p.K, p.N, p.B.data(), p.N);
+        const std::string a_path = TempPath(), c_path = TempPath();
+        StreamGemmOptions options;
+        options.a_offset = rng() % 2 ? 0 : 1 + rng() % 5000;
+        const size_t a_bytes = p.A.size() * sizeof(InputType);
+        bool written = false;
+        if (std::FILE *f = std::fopen(a_path.c_str(), "wb")) {
+            const std::vector<char> header(options.a_offset, 'H');
+            written = std::fwrite(header.data(), 1, header.size(), f) == header.size() &&
+                      std::fwrite(p.A.data(), 1, a_bytes, f) == a_bytes;
+            written = std::fclose(f) == 0 && written;
+        }
+        for (int mode = 0; mode < 2 && written; ++mode) {
+            options.mmap_input = mode == 1;
+            options.panel_rows = rng() % 4 == 0 ? 0 : 1 + static_cast<int>(rng() % 64);
+            const bool threaded = pool && rng() % 2;
+            std::ostringstream what;
+            what << "流式 " << (mode ? "mmap" : "pread") << ", 块 " << options.panel_rows << " 行"
+                 << ", 文件头 " << options.a_offset << (threaded ? ", 线程池" : "");
+            std::string error;
+            StreamGemmStats stats;
+            if (!StreamGemm(multiply, p.M, a_path, packed, c_path, options,
+                            threaded ? pool : nullptr, &stats, &error)) {
+                Check(false, ShapeName(p.M, p.N, p.K) + " " + what.str(), error);
+                continue;
+            }
+            VerifyOutput<OutputType> C(p.M, p.N, p.N);
+            bool read = false;
+            if (std::FILE *f = std::fopen(c_path.c_str(), "rb")) {
+                read = std::fread(C.Data(), sizeof(OutputType), C.data.size(), f) ==
+                           C.data.size() &&
+                       std::fgetc(f) == EOF;
+                std::fclose(f);
+            }
+            Check(read && stats.bytes_read == a_bytes, ShapeName(p.M, p.N, p.K) + " " + what.str(),
+                  "C 文件的大小或读入的字节数不对");
+            CompareAcc(p, C, what.str());
+        }
+        Check(written, ShapeName(p.M, p.N, p.K) + " 流式", "无法写入 A 的文件");
+
+        std::string error;
+        Check(!StreamGemm(multiply, p.M + 1, a_path, packed, c_path, options, nullptr, nullptr,
+                          &error),
+              ShapeName(p.M + 1, p.N, p.K) + " 流式, A 的文件过短", "没有报错");
+        unlink(a_path.c_str());
+        unlink(c_path.c_str());
+        multiply.TileRelease();
+    }
+
+    // QuantizedLinear 的权重写出后重新映射, 两者的输出应逐位相同
+    void VerifyQuantizedWeightFile() {
+        const int M = 1 + rng() % 40, N = 1 + rng() % 80, K = 1 + rng() % 300;
+        std::normal_distribution<float> normal(0.0f, 1.0f);
+        std::vector<float> X(static_cast<size_t>(M) * K), W(static_cast<size_t>(K) * N);
+        for (float &x : X) x = normal(rng);
+        for (float &w : W) w = normal(rng);
+        QuantizedLinear linear(K, N, W.data(), N);
+        const std::string path = TempPath();
+        std::string error;
+        MappedWeights<int8_t> mapped;
+        if (!linear.SaveWeights(path, &error) || !mapped.Open(path, &error)) {
+            Check(false, ShapeName(M, N, K) + " QuantizedLinear 权重文件", error);
+            unlink(path.c_str());
+            return;
+        }
+        QuantizedLinear loaded(mapped.Packed(), mapped.Scales());
+        std::vector<float> want(static_cast<size_t>(M) * N), got(want.size());
+        linear.Forward(M, X.data(), K, want.data(), N);
+        loaded.Forward(M, X.data(), K, got.data(), N);
+        Check(std::memcmp(want.data(), got.data(), want.size() * sizeof(float)) == 0,
+              ShapeName(M, N, K) + " QuantizedLinear 权重文件", "映射后的输出不同");
+        unlink(path.c_str());
+    }
+
+   public:
+    GemmVerifier(uint32_t seed, int case_count, WorkerPool *worker_pool, std::ostream &out)
+        : rng(seed), cases(case_count), pool(worker_pool), log(out) {}
+
+    // 一种类型组合在一个后端上的全部检查; 后端在本机不可用时跳过
+    template <typename InputType, typename OutputType, typename WeightType = InputType>
+    void Verify(GemmBackend backend) {
+        using Multiply = IntelAmxMatrixMultiply<InputType, OutputType, WeightType>;
+        Multiply multiply = Multiply::Create();
+        if (!CreateWithBackend(backend, multiply)) return;
+        const std::string name =
+            std::string(GemmBackendName(backend)) + " " + VerifyTypeName<InputType, WeightType>();
+
+        Begin(name + " Gemm");
+        for (int c = 0; c < cases; ++c) {
+            int M, N, K;
+            NextShape(c, M, N, K);
+            const VerifyProblem<InputType, WeightType> p(M, N, K, rng);
+            VerifyDrivers<InputType, OutputType>(multiply, p);
+        }
+        End();
+
+        Begin(name + " 布局转换");
+        for (int c = 0; c < cases; ++c) {
+            int M, N, K;
+            NextShape(c, M, N, K);
+            VerifyLayout(VerifyProblem<InputType, WeightType>(M, N, K, rng));
+        }
+        End();
+
+        Begin(name + " 后处理");
+        for (int c = 0; c < cases; ++c) {
+            const VerifyProblem<InputType, WeightType> p(1 + rng() % 80, 1 + rng() % 80,
+                                                         1 + rng() % 300, rng);
+            VerifyEpilogue<InputType, OutputType>(multiply, p, pool && c % 2);
+        }
+        End();
+
+        if constexpr (std::is_integral_v<InputType>) {
+            Begin(name + " A 零点");
+            for (int c = 0; c < cases; ++c) {
+                const VerifyProblem<InputType, WeightType> p(1 + rng() % 80, 1 + rng() % 80,
+                                                             1 + rng() % 300, rng);
+                VerifyZeroPoint<InputType, OutputType>(multiply, p, pool && c % 2);
+            }
+            End();
+        }
+
+        Begin(name + " 批量/分组");
+        for (int c = 0; c < std::max(1, cases / 4); ++c) {
+            VerifyBatched<InputType, OutputType, WeightType>(multiply);
+            VerifyGrouped<InputType, OutputType, WeightType>(multiply);
+        }
+        End();
+        multiply.TileRelease();
+    }
+
+    // 所有类型组合在所有后端上的检查
+    void VerifyAll() {
+        for (GemmBackend b : {GemmBackend::AMX, GemmBackend::AVX512_VNNI, GemmBackend::AVX2,
+                              GemmBackend::SCALAR}) {
+            Verify<int8_t, int32_t>(b);
+            Verify<int8_t, int32_t, uint8_t>(b);
+            Verify<uint8_t, int32_t, int8_t>(b);
+            Verify<uint8_t, int32_t>(b);
+        }
+        for (GemmBackend b : {GemmBackend::AMX, GemmBackend::AVX512_BF16, GemmBackend::SCALAR}) {
+            Verify<bfloat16, float>(b);
+        }
+        Begin("后处理饱和");
+        for (int c = 0; c < std::max(1, cases / 4); ++c) {
+            VerifySaturation<int32_t>();
+            VerifySaturation<float>();
+        }
+        End();
+
+        if (pool != nullptr) {
+            Begin("嵌套的线程池调用");
+            for (int c = 0; c < std::max(1, cases / 4); ++c) VerifyNestedRun();
+            End();
+        }
+
+        Begin("bf16 NaN");
+        VerifyBf16NaN();
+        End();
+
+        Begin("权重文件");
+        for (int c = 0; c < std::max(1, cases / 4); ++c) {
+            VerifyWeightFile<int8_t, int32_t, int8_t>();
+            VerifyWeightFile<uint8_t, int32_t, int8_t>();
+            VerifyWeightFile<int8_t, int32_t, uint8_t>();
+            VerifyWeightFile<bfloat16, float, bfloat16>();
+            VerifyQuantizedWeightFile();
+        }
+        End();
+
+        Begin("流式 GEMM");
+        for (int c = 0; c < std::max(1, cases / 4); ++c) {
+            VerifyStream<int8_t, int32_t, int8_t>();
+            VerifyStream<uint8_t, int32_t, int8_t>();
+            VerifyStream<bfloat16, float, bfloat16>();
+        }
+        End();
+
+        Begin("QuantizedLinear");
+        for (int c = 0; c < cases; ++c) VerifyQuantizedLinear(pool && c % 2);
+        End();
+    }
+
+    // 供调用方加入自己的检查 (如教程内核), 计入同一份统计
+    void BeginSection(const std::string &name) { Begin(name); }
+    void EndSection() { End(); }
+    void Record(bool ok, const std::string &what, const std::string &detail) {
+        Check(ok, what, detail);
+    }
+    std::mt19937 &Rng() { return rng; }
+
+    int Checks() const { return total_checks; }
+    int Failures() const { return total_failures; }
+};
@@ -0,0 +1,46 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "amx_thread_pool.h"
+#include "amx_verify.h"
+
+// ctest 运行的正确性检查: 与 amx_bench --verify 相同的随机检查 (不含第1~5版内核),
+// 有失败时返回 1。
+// 不需要参数; 可选 --seed S、--cases N、--threads T (默认 1、24、4, 与 amx_bench 相同)
+int main(int argc, char **argv) {
+    uint32_t seed = 1;
+    int cases = 24, threads = 4;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const std::string key = arg.substr(0, eq);
+        const char *value = "";
+        if (eq != std::string::npos) {
+            value = argv[i] + eq + 1;
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        }
+        if (key == "--seed" && *value != '\0') {
+            seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (key == "--cases" && std::atoi(value) > 0) {
+            cases = std::atoi(value);
+        } else if (key == "--threads" && *value != '\0') {
+            threads = std::atoi(value);
+        } else {
+            std::cerr << "用法: amx_verify [--seed S] [--cases N] [--threads T]\n";
+            return 2;
+        }
+    }
+
+    std::unique_ptr<WorkerPool> pool;
+    if (threads != 1) pool = std::make_unique<WorkerPool>(threads);
+    std::cout << "随机种子: " << seed << ", 每组问题个数: " << cases
+              << ", 线程池: " << (pool ? pool->Size() : 0) << "\n";
+    GemmVerifier verifier(seed, cases, pool.get(), std::cout);
+    verifier.VerifyAll();
+    std::cout << "共 " << verifier.Checks() << " 项, 失败 " << verifier.Failures() << " 项\n";
+    return verifier.Failures() == 0 ? 0 : 1;
+}
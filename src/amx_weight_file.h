@@ -0,0 +1,255 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "amx_bfloat16.h"
+#include "amx_pack.h"
+
+// 预打包权重的文件格式: B 已按 PackedB 的 VNNI tile 顺序排好, 加载时只需 mmap, 内核的
+// _tile_loadd 直接读取映射的页, 没有读入、分配和重新打包的过程。
+//   [0, 128)          WeightFileHeader
+//   tiles_offset      PackedB 的数据 (n_tiles 列, 每列 k_tiles 个 1KB 的 tile), 4KB 对齐
+//   scales_offset     可选, N 个 float: 每输出通道的量化步长 (QuantizedLinear 使用)
+//   col_sums_offset   可选, N 个 int32: 每列的和 (整数权重, A 有零点时补偿用)
+// 各段都按 64 字节对齐, 偏移为 0 表示没有该段。所有字段按本机字节序 (x86 为小端) 存储
+enum class WeightFileType : uint32_t { INT8 = 1, UINT8 = 2, BF16 = 3 };
+
+template <typename DataType>
+constexpr WeightFileType WeightFileTypeOf() {
+    if constexpr (std::is_same_v<DataType, int8_t>) return WeightFileType::INT8;
+    if constexpr (std::is_same_v<DataType, uint8_t>) return WeightFileType::UINT8;
+    static_assert(std::is_same_v<DataType, int8_t> || std::is_same_v<DataType, uint8_t> ||
+                      std::is_same_v<DataType, bfloat16>,
+                  "unsupported weight type");
+    return WeightFileType::BF16;
+}
+
+constexpr char WEIGHT_FILE_MAGIC[8] = {'A', 'M', 'X', 'W', 'G', 'T', '\0', '\0'};
+constexpr uint32_t WEIGHT_FILE_VERSION = 1;
+constexpr uint64_t WEIGHT_FILE_TILES_ALIGN = 4096;  // 数据段从页边界开始
+constexpr uint64_t WEIGHT_FILE_SECTION_ALIGN = 64;
+
+struct WeightFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t type;  // WeightFileType
+    int32_t k, n;
+    int32_t k_tiles, n_tiles;
+    // tile 的几何参数, 加载时须与本程序的打包格式一致
+    int32_t tile_rows;   // 16
+    int32_t tile_bytes;  // 1024
+    int32_t pack_n;      // 每个 B tile 覆盖的列数 (PACK_TILE_N)
+    int32_t vnni_group;  // VNNI 交织的 K 元素个数
+    uint64_t tiles_offset, tiles_bytes;
+    uint64_t scales_offset;
+    uint64_t col_sums_offset;
+    uint64_t file_bytes;
+    uint8_t reserved[40];
+};
+static_assert(sizeof(WeightFileHeader) == 128, "weight file header must stay 128 bytes");
+
+inline uint64_t AlignWeightFileOffset(uint64_t offset, uint64_t align) {
+    return (offset + align - 1) / align * align;
+}
+
+inline bool WeightFileError(std::string *error, const std::string &message) {
+    if (error != nullptr) *error = message;
+    return false;
+}
+
+// 把 B 写成权重文件, scales 为可选的 N 个每通道步长。先写入 path.tmp 再改名,
+// 中途失败不会留下不完整的文件
+template <typename DataType>
+bool SaveWeightFile(const std::string &path, const PackedB<DataType> &B,
+                    const float *scales = nullptr, std::string *error = nullptr) {
+    WeightFileHeader h{};
+    std::memcpy(h.magic, WEIGHT_FILE_MAGIC, sizeof(h.magic));
+    h.version = WEIGHT_FILE_VERSION;
+    h.type = static_cast<uint32_t>(WeightFileTypeOf<DataType>());
+    h.k = B.K(), h.n = B.N();
+    h.k_tiles = B.KTiles(), h.n_tiles = B.NTiles();
+    h.tile_rows = 16, h.tile_bytes = PACK_TILE_BYTES;
+    h.pack_n = PACK_TILE_N, h.vnni_group = VNNI_GROUP<DataType>;
+    h.tiles_offset = WEIGHT_FILE_TILES_ALIGN;
+    h.tiles_bytes = B.Bytes();
+    uint64_t end = h.tiles_offset + h.tiles_bytes;
+    const uint64_t vector_bytes = static_cast<uint64_t>(B.N()) * 4;
+    if (scales != nullptr) {
+        h.scales_offset = AlignWeightFileOffset(end, WEIGHT_FILE_SECTION_ALIGN);
+        end = h.scales_offset + vector_bytes;
+    }
+    if (B.ColumnSums() != nullptr) {
+        h.col_sums_offset = AlignWeightFileOffset(end, WEIGHT_FILE_SECTION_ALIGN);
+        end = h.col_sums_offset + vector_bytes;
+    }
+    h.file_bytes = end;
+
+    const std::string tmp = path + ".tmp";
+    std::FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (f == nullptr) return WeightFileError(error, "无法创建 " + tmp);
+    auto put = [f](uint64_t offset, const void *src, size_t bytes) {
+        return std::fseek(f, static_cast<long>(offset), SEEK_SET) == 0 &&
+               std::fwrite(src, 1, bytes, f) == bytes;
+    };
+    bool ok = put(0, &h, sizeof(h)) && put(h.tiles_offset, B.Data(), h.tiles_bytes);
+    if (ok && h.scales_offset != 0) ok = put(h.scales_offset, scales, vector_bytes);
+    if (ok && h.col_sums_offset != 0) ok = put(h.col_sums_offset, B.ColumnSums(), vector_bytes);
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return WeightFileError(error, "写入 " + path + " 失败");
+    }
+    return true;
+}
+
+// 只读映射的权重文件。Packed() 引用映射中的数据, 可直接传给 Gemm / QuantizedLinear,
+// 在 Close 或析构之前有效。映射为 MAP_PRIVATE 的只读页, 多个进程加载同一文件时共享
+// 页缓存中的同一份物理内存。populate 为 true 时在 Open 中预读所有页 (MAP_POPULATE),
+// 否则只建议内核预读 (MADV_WILLNEED), 第一次 Gemm 时才会缺页
+template <typename DataType>
+class MappedWeights {
+   private:
+    void *mapping = nullptr;
+    size_t length = 0;
+    WeightFileHeader header{};
+    std::optional<PackedB<DataType>> packed;
+
+    bool Validate(const std::string &path, std::string *error) const {
+        const WeightFileHeader &h = header;
+        auto fail = [&](const char *what) { return WeightFileError(error, path + ": " + what); };
+        if (std::memcmp(h.magic, WEIGHT_FILE_MAGIC, sizeof(h.magic)) != 0) {
+            return fail("不是权重文件");
+        }
+        if (h.version != WEIGHT_FILE_VERSION) return fail("不支持的版本");
+        if (h.type != static_cast<uint32_t>(WeightFileTypeOf<DataType>())) {
+            return fail("权重类型不符");
+        }
+        if (h.tile_rows != 16 || h.tile_bytes != PACK_TILE_BYTES || h.pack_n != PACK_TILE_N ||
+            h.vnni_group != VNNI_GROUP<DataType>) {
+            return fail("tile 格式与本程序不同");
+        }
+        // 形状来自文件: 先限制范围 (补齐到整 tile 后仍在 int 范围内), 再以 int64 计算 tile 数
+        const int64_t k = h.k, n = h.n;
+        constexpr int64_t TK = TILE_K<DataType>;
+        if (k <= 0 || n <= 0 || k > INT32_MAX - TK || n > INT32_MAX - PACK_TILE_N ||
+            h.k_tiles != (k + TK - 1) / TK || h.n_tiles != (n + PACK_TILE_N - 1) / PACK_TILE_N ||
+            h.tiles_bytes != static_cast<uint64_t>(h.k_tiles) * h.n_tiles * PACK_TILE_BYTES) {
+            return fail("形状与数据段的大小不一致");
+        }
+        if (h.file_bytes != length) return fail("文件大小不符 (可能被截断)");
+        const uint64_t vector_bytes = static_cast<uint64_t>(h.n) * 4;
+        auto section_ok = [&](uint64_t offset, uint64_t bytes) {
+            return offset % WEIGHT_FILE_SECTION_ALIGN == 0 && offset >= sizeof(WeightFileHeader) &&
+                   offset <= length && bytes <= length - offset;
+        };
+        if (!section_ok(h.tiles_offset, h.tiles_bytes) ||
+            (h.scales_offset != 0 && !section_ok(h.scales_offset, vector_bytes)) ||
+            (h.col_sums_offset != 0 && !section_ok(h.col_sums_offset, vector_bytes))) {
+            return fail("段的偏移越界或未对齐");
+        }
+        return true;
+    }
+
+    const char *At(uint64_t offset) const { return static_cast<const char *>(mapping) + offset; }
+
+   public:
+    MappedWeights() = default;
+    ~MappedWeights() { Close(); }
+
+    MappedWeights(const MappedWeights &) = delete;
+    MappedWeights &operator=(const MappedWeights &) = delete;
+
+    // 映射的地址不随对象移动, Packed() 中的指针仍然有效
+    MappedWeights(MappedWeights &&other) noexcept
+        : mapping(std::exchange(other.mapping, nullptr)),
+          length(std::exchange(other.length, 0)),
+          header(std::exchange(other.header, WeightFileHeader{})),
+          packed(std::move(other.packed)) {
+        other.packed.reset();
+    }
+
+    MappedWeights &operator=(MappedWeights &&other) noexcept {
+        if (this != &other) {
+            Close();
+            mapping = std::exchange(other.mapping, nullptr);
+            length = std::exchange(other.length, 0);
+            header = std::exchange(other.header, WeightFileHeader{});
+            packed = std::move(other.packed);
+            other.packed.reset();
+        }
+        return *this;
+    }
+
+    // 失败时返回 false, 原因写入 error
+    bool Open(const std::string &path, std::string *error = nullptr, bool populate = false) {
+        Close();
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return WeightFileError(error, "无法打开 " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(WeightFileHeader)) {
+            close(fd);
+            return WeightFileError(error, path + ": 不是权重文件");
+        }
+        length = static_cast<size_t>(st.st_size);
+        mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE | (populate ? MAP_POPULATE : 0),
+                       fd, 0);
+        close(fd);  // 映射建立后不再需要文件描述符
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            length = 0;
+            return WeightFileError(error, "无法映射 " + path);
+        }
+        std::memcpy(&header, mapping, sizeof(header));
+        if (!Validate(path, error)) {
+            Close();
+            return false;
+        }
+        if (!populate) madvise(mapping, length, MADV_WILLNEED);
+        const auto *col_sums =
+            header.col_sums_offset != 0
+                ? reinterpret_cast<const int32_t *>(At(header.col_sums_offset))
+                : nullptr;
+        packed = PackedB<DataType>::Wrap(
+            header.k, header.n, reinterpret_cast<const DataType *>(At(header.tiles_offset)),
+            col_sums);
+        return true;
+    }
+
+    // 同时清空 header, 之后 (以及 Open 失败后) K()/N() 为 0
+    void Close() {
+        packed.reset();
+        if (mapping != nullptr) munmap(mapping, length);
+        mapping = nullptr;
+        length = 0;
+        header = WeightFileHeader{};
+    }
+
+    bool IsOpen() const { return mapping != nullptr; }
+    int K() const { return header.k; }
+    int N() const { return header.n; }
+    const WeightFileHeader &Header() const { return header; }
+    // 只能在 Open 成功之后调用
+    const PackedB<DataType> &Packed() const {
+        assert(packed.has_value());
+        return *packed;
+    }
+
+    // 每通道的量化步长 (长度 N), 文件中没有时为空
+    const float *Scales() const {
+        if (header.scales_offset == 0) return nullptr;
+        return reinterpret_cast<const float *>(At(header.scales_offset));
+    }
+};
@@ -0,0 +1,390 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "amx_cpu.h"
+#include "amx_pack.h"
+
+// 没有 AMX 时使用的 int8 GEMM 内核, 与 AMX 内核读取相同的 B 格式 (BTiles),
+// 语义同 IntelAmxMatrixMultiply::Gemm: C[M x N] = A[M x K] * B[K x N];
+// A、B 各自可以是 int8 或 uint8
+
+// 读取 A 第 k 个元素开始的 4 字节组 (int8 为 4 个元素, bf16 为 2 个), K 尾部不足的部分补 0。
+// 完整的组用定长拷贝, 编译为一条 32 位加载; 变长的 memcpy 只留给最后一组
+template <typename DataType>
+inline int32_t LoadAGroup(const DataType *a, int k, int K) {
+    constexpr int G = 4 / sizeof(DataType);
+    int32_t v = 0;
+    if (k + G <= K) {
+        std::memcpy(&v, a + k, sizeof(v));
+    } else {
+        std::memcpy(&v, a + k, (K - k) * sizeof(DataType));
+    }
+    return v;
+}
+
+// int8/uint8 -> int32 与 bf16 -> fp32 共用的标量实现
+template <typename InputType, typename OutputType, typename WeightType>
+inline void GemmScalar(int M, int N, int K, const InputType *A, int lda,
+                       const BTiles<WeightType> &B, OutputType *C, int ldc) {
+    constexpr int G = VNNI_GROUP<InputType>;
+    for (int i = 0; i < M; ++i) {
+        const InputType *a = A + static_cast<size_t>(i) * lda;
+        for (int j = 0; j < N; ++j) {
+            OutputType sum = 0;
+            for (int k = 0; k < K; ++k) {
+                const WeightType b = B.Group(k, j)[k % G];
+                sum += static_cast<OutputType>(a[k]) * static_cast<OutputType>(b);
+            }
+            C[static_cast<size_t>(i) * ldc + j] = sum;
+        }
+    }
+}
+
+// B 的一个 VNNI 行 (64 字节) 正好是 16 列的 int32 向量。vpdpbusd 只支持 u8 x s8:
+//   u8 x s8 直接计算; s8 x u8 交换两个操作数;
+//   s8 x s8 把 A 异或 0x80 变成 a + 128, 最后减去 128 * B 的列和;
+//   u8 x u8 把 B 异或 0x80 变成 b - 128, 最后加上 128 * A 的行和
+template <typename InputType, typename WeightType>
+TARGET_AVX512_VNNI inline void GemmAvx512Vnni(int M, int N, int K, const InputType *A, int lda,
+                                              const BTiles<WeightType> &B, int32_t *C, int ldc) {
+    constexpr bool A_SIGNED = std::is_signed_v<InputType>;
+    constexpr bool B_SIGNED = std::is_signed_v<WeightType>;
+    const int MR = 4;
+    const int groups = (K + 3) / 4;
+    const __m512i ones = _mm512_set1_epi8(1);
+    const __m512i sign = _mm512_set1_epi8(static_cast<char>(0x80));
+    for (int j = 0; j < N; j += 16) {
+        const __mmask16 mask = static_cast<__mmask16>((1u << std::min(16, N - j)) - 1);
+
+        __m512i bias = _mm512_setzero_si512();
+        if constexpr (A_SIGNED && B_SIGNED) {
+            for (int g = 0; g < groups; ++g) {
+                __m512i b = _mm512_maskz_loadu_epi32(mask, B.Group(g * 4, j));
+                bias = _mm512_dpbusd_epi32(bias, ones, b);
+            }
+            bias = _mm512_slli_epi32(bias, 7);
+        }
+
+        for (int i = 0; i < M; i += MR) {
+            // 不足 MR 行时重复计算第 i 行, 只写回有效的行
+            const int mr = std::min(MR, M - i);
+            const InputType *a[MR];
+            for (int r = 0; r < MR; ++r) a[r] = A + static_cast<size_t>(i + (r < mr ? r : 0)) * lda;
+
+            __m512i acc[MR], row_sum[MR];
+            for (int r = 0; r < MR; ++r) {
+                acc[r] = _mm512_setzero_si512();
+                row_sum[r] = _mm512_setzero_si512();
+            }
+            for (int g = 0; g < groups; ++g) {
+                __m512i b = _mm512_maskz_loadu_epi32(mask, B.Group(g * 4, j));
+                if constexpr (!A_SIGNED && !B_SIGNED) b = _mm512_xor_si512(b, sign);
+                for (int r = 0; r < MR; ++r) {
+                    __m512i av = _mm512_set1_epi32(LoadAGroup(a[r], g * 4, K));
+                    if constexpr (A_SIGNED && B_SIGNED) {
+                        acc[r] = _mm512_dpbusd_epi32(acc[r], _mm512_xor_si512(av, sign), b);
+                    } else if constexpr (A_SIGNED) {
+                        acc[r] = _mm512_dpbusd_epi32(acc[r], b, av);
+                    } else {
+                        acc[r] = _mm512_dpbusd_epi32(acc[r], av, b);
+                        if constexpr (!B_SIGNED) {
+                            row_sum[r] = _mm512_dpbusd_epi32(row_sum[r], av, ones);
+                        }
+                    }
+                }
+            }
+            for (int r = 0; r < mr; ++r) {
+                __m512i c = _mm512_sub_epi32(acc[r], bias);
+                if constexpr (!A_SIGNED && !B_SIGNED) {
+                    c = _mm512_add_epi32(c, _mm512_slli_epi32(row_sum[r], 7));
+                }
+                _mm512_mask_storeu_epi32(C + static_cast<size_t>(i + r) * ldc + j, mask, c);
+            }
+        }
+    }
+}
+
+// 8 位元素按各自的符号扩展为 int16
+template <typename DataType>
+TARGET_AVX2 inline __m256i Widen8To16(__m128i v) {
+    if constexpr (std::is_signed_v<DataType>) {
+        return _mm256_cvtepi8_epi16(v);
+    } else {
+        return _mm256_cvtepu8_epi16(v);
+    }
+}
+
+// AVX2 没有 VNNI, 把 8 位元素扩展为 int16 后用 vpmaddwd 精确累加;
+// 每列得到两个部分和 (k0k1, k2k3), 最后用 hadd 合并
+template <typename InputType, typename WeightType>
+TARGET_AVX2 inline void GemmAvx2(int M, int N, int K, const InputType *A, int lda,
+                                 const BTiles<WeightType> &B, int32_t *C, int ldc) {
+    const int MR = 2;
+    const int groups = (K + 3) / 4;
+    for (int j = 0; j < N; j += 8) {
+        const int nn = std::min(8, N - j);
+        const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(nn),
+                                                _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        for (int i = 0; i < M; i += MR) {
+            const int mr = std::min(MR, M - i);
+            const InputType *a[MR];
+            for (int r = 0; r < MR; ++r) a[r] = A + static_cast<size_t>(i + (r < mr ? r : 0)) * lda;
+
+            __m256i acc_lo[MR], acc_hi[MR];
+            for (int r = 0; r < MR; ++r) {
+                acc_lo[r] = _mm256_setzero_si256();
+                acc_hi[r] = _mm256_setzero_si256();
+            }
+            for (int g = 0; g < groups; ++g) {
+                __m256i b = _mm256_maskload_epi32(
+                    reinterpret_cast<const int *>(B.Group(g * 4, j)), mask);
+                __m256i b_lo = Widen8To16<WeightType>(_mm256_castsi256_si128(b));
+                __m256i b_hi = Widen8To16<WeightType>(_mm256_extracti128_si256(b, 1));
+                for (int r = 0; r < MR; ++r) {
+                    __m256i av =
+                        Widen8To16<InputType>(_mm_set1_epi32(LoadAGroup(a[r], g * 4, K)));
+                    acc_lo[r] = _mm256_add_epi32(acc_lo[r], _mm256_madd_epi16(av, b_lo));
+                    acc_hi[r] = _mm256_add_epi32(acc_hi[r], _mm256_madd_epi16(av, b_hi));
+                }
+            }
+            for (int r = 0; r < mr; ++r) {
+                // hadd 的结果顺序为 [c0 c1 c4 c5 | c2 c3 c6 c7], 再按 64 位重排
+                __m256i sum = _mm256_permute4x64_epi64(_mm256_hadd_epi32(acc_lo[r], acc_hi[r]),
+                                                       0xD8);
+                _mm256_maskstore_epi32(
+                    reinterpret_cast<int *>(C + static_cast<size_t>(i + r) * ldc + j), mask, sum);
+            }
+        }
+    }
+}
+
+// vdpbf16ps: 每个 fp32 累加器一次累加一对 bf16 乘积, B 的一个 VNNI 行同样是 16 列;
+// K 为奇数时 A 的最后一对补 0
+TARGET_AVX512_BF16 inline void GemmBf16Avx512(int M, int N, int K, const bfloat16 *A, int lda,
+                                              const BTiles<bfloat16> &B, float *C, int ldc) {
+    const int MR = 4;
+    const int pairs = (K + 1) / 2;
+    for (int j = 0; j < N; j += 16) {
+        const __mmask16 mask = static_cast<__mmask16>((1u << std::min(16, N - j)) - 1);
+        for (int i = 0; i < M; i += MR) {
+            const int mr = std::min(MR, M - i);
+            const bfloat16 *a[MR];
+            for (int r = 0; r < MR; ++r) a[r] = A + static_cast<size_t>(i + (r < mr ? r : 0)) * lda;
+
+            __m512 acc[MR];
+            for (int r = 0; r < MR; ++r) acc[r] = _mm512_setzero_ps();
+            for (int p = 0; p < pairs; ++p) {
+                __m512i b = _mm512_maskz_loadu_epi32(mask, B.Group(p * 2, j));
+                for (int r = 0; r < MR; ++r) {
+                    uint32_t pair = a[r][p * 2].bits;
+                    if (p * 2 + 1 < K) std::memcpy(&pair, a[r] + p * 2, sizeof(pair));
+                    __m512i av = _mm512_set1_epi32(static_cast<int>(pair));
+                    acc[r] = _mm512_dpbf16_ps(acc[r], (__m512bh)av, (__m512bh)b);
+                }
+            }
+            for (int r = 0; r < mr; ++r) {
+                _mm512_mask_storeu_ps(C + static_cast<size_t>(i + r) * ldc + j, mask, acc[r]);
+            }
+        }
+    }
+}
+
+// ---------------- 小 M (GEMV) 内核 ----------------
+//
+// 批大小为 1~4 的在线推理中 M 很小: AMX 的 tile 虽然可以配置为只有 M 行, 但每个 K 步仍要
+// 加载 A/B tile、每个块要读写 C tile, 这些固定开销在只有几行时占了大头。下面的内核用 AVX-512
+// 直接读取与 AMX 内核相同的 B (预打包的 tile 或行跨度 VNNI): 一次计算 MR 行 x NB 个 N tile
+// (每个 16 列), B 的每个 VNNI 行 (16 列 x 4 字节) 只加载一次, 由 MR 行共用。
+// MR * NB 个累加器互不依赖, 足以掩盖乘加指令的延迟; 它们必须一直留在寄存器中, 因此内层循环
+// 没有分支和函数调用 (K 不是组长的整数倍时, 由 GemvAvx512 把 A 的行复制到补 0 的缓冲区),
+// 固定次数的循环要求完全展开
+
+// 第 j 列起 NB 个 N tile 的列掩码和 K = 0 处的地址 (字节), 超出 N 的 tile 掩码为 0, 不访问内存
+template <int NB, typename WeightType>
+inline void GemvColumns(int N, int j, const BTiles<WeightType> &B, __mmask16 *mask,
+                        const char **col) {
+    for (int t = 0; t < NB; ++t) {
+        const int cols = std::max(0, std::min(16, N - j - t * 16));
+        mask[t] = static_cast<__mmask16>((1u << cols) - 1);
+        col[t] = reinterpret_cast<const char *>(cols > 0 ? B.At(0, j + t * 16) : B.data);
+    }
+}
+
+// 第 g 个 VNNI 行相对 K = 0 的字节偏移
+template <typename WeightType>
+inline size_t GemvRowOffset(const BTiles<WeightType> &B, int g) {
+    return g / 16 * B.k_step * sizeof(WeightType) + g % 16 * B.stride;
+}
+
+// int8/uint8: 符号的处理与 GemmAvx512Vnni 相同, s8 x s8 的列和在主循环中同时累加。
+// A 的每行须可以读到 4 字节对齐的组末尾, 超出 K 的部分为 0
+template <int MR, int NB, typename InputType, typename WeightType>
+TARGET_AVX512_VNNI inline void GemvBlockAvx512Vnni(int mr, int N, int K, const InputType *A,
+                                                   int lda, const BTiles<WeightType> &B, int j,
+                                                   int32_t *C, int ldc) {
+    constexpr bool A_SIGNED = std::is_signed_v<InputType>;
+    constexpr bool B_SIGNED = std::is_signed_v<WeightType>;
+    const __m512i ones = _mm512_set1_epi8(1);
+    const __m512i sign = _mm512_set1_epi8(static_cast<char>(0x80));
+    const int groups = (K + 3) / 4;
+    const InputType *a[MR];
+    for (int r = 0; r < MR; ++r) a[r] = A + static_cast<size_t>(r < mr ? r : 0) * lda;
+    __mmask16 mask[NB];
+    const char *col[NB];
+    GemvColumns<NB>(N, j, B, mask, col);
+
+    __m512i acc[MR][NB], row_sum[MR], col_sum[NB];
+#pragma GCC unroll 4
+    for (int r = 0; r < MR; ++r) {
+#pragma GCC unroll 8
+        for (int t = 0; t < NB; ++t) acc[r][t] = _mm512_setzero_si512();
+        row_sum[r] = _mm512_setzero_si512();
+    }
+#pragma GCC unroll 8
+    for (int t = 0; t < NB; ++t) col_sum[t] = _mm512_setzero_si512();
+
+    for (int g = 0; g < groups; ++g) {
+        const size_t offset = GemvRowOffset(B, g);
+        __m512i b[NB];
+#pragma GCC unroll 8
+        for (int t = 0; t < NB; ++t) {
+            b[t] = _mm512_maskz_loadu_epi32(mask[t], col[t] + offset);
+            if constexpr (!A_SIGNED && !B_SIGNED) b[t] = _mm512_xor_si512(b[t], sign);
+            if constexpr (A_SIGNED && B_SIGNED) {
+                col_sum[t] = _mm512_dpbusd_epi32(col_sum[t], ones, b[t]);
+            }
+        }
+#pragma GCC unroll 4
+        for (int r = 0; r < MR; ++r) {
+            int32_t group;
+            std::memcpy(&group, a[r] + g * 4, sizeof(group));
+            __m512i av = _mm512_set1_epi32(group);
+            if constexpr (A_SIGNED && B_SIGNED) av = _mm512_xor_si512(av, sign);
+#pragma GCC unroll 8
+            for (int t = 0; t < NB; ++t) {
+                if constexpr (A_SIGNED && !B_SIGNED) {
+                    acc[r][t] = _mm512_dpbusd_epi32(acc[r][t], b[t], av);
+                } else {
+                    acc[r][t] = _mm512_dpbusd_epi32(acc[r][t], av, b[t]);
+                }
+            }
+            if constexpr (!A_SIGNED && !B_SIGNED) {
+                row_sum[r] = _mm512_dpbusd_epi32(row_sum[r], av, ones);
+            }
+        }
+    }
+
+    // 完全展开后 acc 的下标都是常量, 累加器才不会被放到栈上
+#pragma GCC unroll 4
+    for (int r = 0; r < MR; ++r) {
+        if (r >= mr) break;
+#pragma GCC unroll 8
+        for (int t = 0; t < NB; ++t) {
+            __m512i c = acc[r][t];
+            if constexpr (A_SIGNED && B_SIGNED) {
+                c = _mm512_sub_epi32(c, _mm512_slli_epi32(col_sum[t], 7));
+            }
+            if constexpr (!A_SIGNED && !B_SIGNED) {
+                c = _mm512_add_epi32(c, _mm512_slli_epi32(row_sum[r], 7));
+            }
+            _mm512_mask_storeu_epi32(C + static_cast<size_t>(r) * ldc + j + t * 16, mask[t], c);
+        }
+    }
+}
+
+// bf16: 每个 VNNI 行为 16 列 x 一对 bf16; K 为奇数时 A 的每行须多一个 0
+template <int MR, int NB>
+TARGET_AVX512_BF16 inline void GemvBlockBf16Avx512(int mr, int N, int K, const bfloat16 *A,
+                                                   int lda, const BTiles<bfloat16> &B, int j,
+                                                   float *C, int ldc) {
+    const int pairs = (K + 1) / 2;
+    const bfloat16 *a[MR];
+    for (int r = 0; r < MR; ++r) a[r] = A + static_cast<size_t>(r < mr ? r : 0) * lda;
+    __mmask16 mask[NB];
+    const char *col[NB];
+    GemvColumns<NB>(N, j, B, mask, col);
+
+    __m512 acc[MR][NB];
+#pragma GCC unroll 4
+    for (int r = 0; r < MR; ++r) {
+#pragma GCC unroll 8
+        for (int t = 0; t < NB; ++t) acc[r][t] = _mm512_setzero_ps();
+    }
+
+    for (int p = 0; p < pairs; ++p) {
+        const size_t offset = GemvRowOffset(B, p);
+        __m512i b[NB];
+#pragma GCC unroll 8
+        for (int t = 0; t < NB; ++t) b[t] = _mm512_maskz_loadu_epi32(mask[t], col[t] + offset);
+#pragma GCC unroll 4
+        for (int r = 0; r < MR; ++r) {
+            int32_t pair;
+            std::memcpy(&pair, a[r] + p * 2, sizeof(pair));
+            const __m512i av = _mm512_set1_epi32(pair);
+#pragma GCC unroll 8
+            for (int t = 0; t < NB; ++t) {
+                acc[r][t] = _mm512_dpbf16_ps(acc[r][t], (__m512bh)av, (__m512bh)b[t]);
+            }
+        }
+    }
+
+#pragma GCC unroll 4
+    for (int r = 0; r < MR; ++r) {
+        if (r >= mr) break;
+#pragma GCC unroll 8
+        for (int t = 0; t < NB; ++t) {
+            _mm512_mask_storeu_ps(C + static_cast<size_t>(r) * ldc + j + t * 16, mask[t],
+                                  acc[r][t]);
+        }
+    }
+}
+
+// C[M x N] = A[M x K] * B[K x N], 每 4 行一组; B 的格式与 AMX 内核相同 (BTiles)
+template <typename InputType, typename OutputType, typename WeightType>
+inline void GemvAvx512(int M, int N, int K, const InputType *A, int lda,
+                       const BTiles<WeightType> &B, OutputType *C, int ldc) {
+    constexpr int G = 4 / sizeof(InputType);
+    const int padded_k = (K + G - 1) / G * G;
+    static thread_local std::vector<InputType> padded;
+    auto block = [&](auto mr_tag, int mr, const InputType *a, int ld, OutputType *c) {
+        constexpr int MR = decltype(mr_tag)::value;
+        constexpr int NB = MR == 1 ? 8 : 4;
+        for (int j = 0; j < N; j += NB * 16) {
+            if constexpr (std::is_same_v<InputType, bfloat16>) {
+                GemvBlockBf16Avx512<MR, NB>(mr, N, K, a, ld, B, j, c, ldc);
+            } else {
+                GemvBlockAvx512Vnni<MR, NB>(mr, N, K, a, ld, B, j, c, ldc);
+            }
+        }
+    };
+    for (int i = 0; i < M; i += 4) {
+        const int mr = std::min(4, M - i);
+        const InputType *a = A + static_cast<size_t>(i) * lda;
+        int ld = lda;
+        OutputType *c = C + static_cast<size_t>(i) * ldc;
+        if (padded_k != K) {
+            // 最后一组不完整: 复制这几行并补 0, 内核只做完整的 4 字节加载
+            padded.assign(static_cast<size_t>(mr) * padded_k, InputType{});
+            for (int r = 0; r < mr; ++r) {
+                std::copy_n(a + static_cast<size_t>(r) * lda, K, padded.data() + r * padded_k);
+            }
+            a = padded.data();
+            ld = padded_k;
+        }
+        if (mr == 1) {
+            block(std::integral_constant<int, 1>{}, mr, a, ld, c);
+        } else if (mr == 2) {
+            block(std::integral_constant<int, 2>{}, mr, a, ld, c);
+        } else {
+            block(std::integral_constant<int, 4>{}, mr, a, ld, c);
+        }
+    }
+}
@@ -0,0 +1,162 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "amx_gemm.h"
+#include "amx_thread_pool.h"
+
+// 测试代码: 任意形状的 GEMM, 默认使用线上层的形状 384x1000x768
+// 用法: matrix_mul_amx_gemm [M N K 循环次数 线程数 预取距离]
+// 预取距离默认自动选择 (-1); 为 sweep 时依次测试 0/1/2/4/8, 比较不同预取距离下的性能
+//       matrix_mul_amx_gemm batch [问题个数 循环次数 线程数]
+// 批量模式: 第1~5版的 16x64x64 形状, 比较逐个调用 Gemm 与一次调用 GemmBatched
+static int RunBatch(int argc, char **argv) {
+    const int M = 16, N = 64, K = 64;
+    int batch = argc > 2 ? std::atoi(argv[2]) : 4096;
+    int iteration = argc > 3 ? std::atoi(argv[3]) : 100;
+    int thread_count = argc > 4 ? std::atoi(argv[4]) : 1;
+
+    // 每个问题的 B 已是 VNNI 格式: (K / 4) 行, 每行 N * 4 字节
+    Matrix<int8_t> A(batch, M * K);
+    Matrix<int8_t> B(batch, K * N);
+    Matrix<int32_t> C(batch, M * N);
+    A.Fill(2);
+    B.Fill(2);
+
+    auto multiply = IntelAmxMatrixMultiply<int8_t, int32_t>::Create();
+    std::unique_ptr<WorkerPool> pool;
+    if (thread_count > 1) pool = std::make_unique<WorkerPool>(thread_count);
+
+    auto loop = [&] {
+        for (int p = 0; p < batch; ++p) {
+            multiply.Gemm(M, N, K, A.Data() + p * M * K, K, B.Data() + p * K * N, N * 4,
+                          C.Data() + p * M * N, N);
+        }
+    };
+    auto batched = [&] {
+        if (pool) {
+            multiply.GemmBatched(M, N, K, A.Data(), K, M * K, B.Data(), N * 4, K * N, C.Data(),
+                                 N, M * N, batch, *pool);
+        } else {
+            multiply.GemmBatched(M, N, K, A.Data(), K, M * K, B.Data(), N * 4, K * N, C.Data(),
+                                 N, M * N, batch);
+        }
+    };
+    auto time = [&](auto &&fn) {
+        fn();  // 预热
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iteration; i++) fn();
+        auto t1 = std::chrono::high_resolution_clock::now();
+        return static_cast<double>((t1 - t0).count());
+    };
+
+    const auto items = static_cast<double>(int64_t(M) * N * K * 2 * batch * iteration);
+    std::cout << "后端: " << GemmBackendName(multiply.Backend()) << ", 形状: " << M << "x" << N
+              << "x" << K << ", 问题个数: " << batch << ", 线程数: " << thread_count << "\n";
+    if (!pool) {
+        const double cost_time = time(loop);
+        std::cout << "逐个调用 Gemm, GOPS: " << std::fixed << std::setprecision(4)
+                  << items / cost_time << "GOPS" << std::defaultfloat << "\n";
+    }
+    const double cost_time = time(batched);
+    std::cout << "GemmBatched, GOPS: " << std::fixed << std::setprecision(4) << items / cost_time
+              << "GOPS" << std::defaultfloat << "\n";
+
+    int errors = 0;
+    for (int i = 0; i < C.Size(); ++i) {
+        if (C.Data()[i] != 4 * K) ++errors;
+    }
+    std::cout << "结果错误数: " << errors << "\n";
+    multiply.TileRelease();
+    return errors == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && std::strcmp(argv[1], "batch") == 0) return RunBatch(argc, argv);
+
+    int M = argc > 1 ? std::atoi(argv[1]) : 384;
+    int N = argc > 2 ? std::atoi(argv[2]) : 1000;
+    int K = argc > 3 ? std::atoi(argv[3]) : 768;
+    int iteration = argc > 4 ? std::atoi(argv[4]) : 1000;
+    int thread_count = argc > 5 ? std::atoi(argv[5]) : 1;
+    const bool sweep = argc > 6 && std::strcmp(argv[6], "sweep") == 0;
+
+    Matrix<int8_t> A(M, K);
+    Matrix<int8_t> B(K, N);
+    Matrix<int32_t> C(M, N);
+
+    // 初始化矩阵
+    A.Fill(2);
+    B.Fill(2);
+    C.Fill(0);
+
+    // 权重只打包一次, 之后的每次调用直接读取连续的 1KB tile
+    auto p0 = std::chrono::high_resolution_clock::now();
+    PackedB<int8_t> packed(K, N, B.Data(), N);
+    auto p1 = std::chrono::high_resolution_clock::now();
+
+    // 执行乘法
+    auto multiply = IntelAmxMatrixMultiply<int8_t, int32_t>::Create();
+    if (argc > 6 && !sweep) multiply.SetPrefetchDistance(std::atoi(argv[6]));
+
+    multiply.Gemm(M, A.Data(), K, packed, C.Data(), N);
+    int errors = 0;
+    for (int i = 0; i < C.Size(); ++i) {
+        if (C.Data()[i] != 4 * K) ++errors;
+    }
+
+    // 多线程模式: 一个 GEMM 的 C 按二维宏块网格分给常驻线程并行计算, 共享 A 和打包好的 B;
+    // 先预热一次, 让每个线程加载好自己的 tile 配置, 计时不包含线程创建
+    std::unique_ptr<WorkerPool> pool;
+    if (thread_count > 1) {
+        pool = std::make_unique<WorkerPool>(thread_count);
+        multiply.Gemm(M, A.Data(), K, packed, C.Data(), N, *pool);
+        for (int i = 0; i < C.Size(); ++i) {
+            if (C.Data()[i] != 4 * K) ++errors;
+        }
+    }
+    auto run = [&] {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iteration; i++) {
+            if (pool) {
+                multiply.Gemm(M, A.Data(), K, packed, C.Data(), N, *pool);
+            } else {
+                multiply.Gemm(M, A.Data(), K, packed, C.Data(), N);
+            }
+        }
+        auto t1 = std::chrono::high_resolution_clock::now();
+        return static_cast<double>((t1 - t0).count());
+    };
+    auto ops_per_matmul = int64_t(M) * N * K * 2;
+    auto items = static_cast<double>(ops_per_matmul * iteration);
+
+    if (sweep) {
+        for (int distance : {0, 1, 2, 4, 8}) {
+            multiply.SetPrefetchDistance(distance);
+            run();  // 预热
+            auto cost_time = run();
+            std::cout << "预取距离: " << distance << ", cost time:" << cost_time / 1e9
+                      << "s, GOPS: " << std::fixed << std::setprecision(4) << items / cost_time
+                      << "GOPS" << std::defaultfloat << "\n";
+        }
+    }
+    auto cost_time = run();
+
+    multiply.TileRelease();
+
+    auto gops = items / cost_time;
+    std::cout << "后端: " << GemmBackendName(multiply.Backend()) << "\n";
+    std::cout << "形状: " << M << "x" << N << "x" << K << ", 结果错误数: " << errors << "\n";
+    std::cout << "B 打包耗时: " << static_cast<double>((p1 - p0).count()) / 1e3 << "us\n";
+    std::cout << "线程数: " << thread_count << ", 循环次数: " << iteration
+              << ", 预取距离: " << multiply.PrefetchDistance() << "\n";
+    std::cout << "Intel Amx cost time:" << cost_time / 1e9 << "s, GOPS: " << std::fixed
+              << std::setprecision(4) << gops << "GOPS" << "\n";
+
+    return errors == 0 ? 0 : 1;
+}
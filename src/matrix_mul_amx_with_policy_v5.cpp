@@ -73,6 +73,8 @@ class IntelAmxMatrixMultiply {
             tileinfo.colsb[i] = COLSB;
             tileinfo.rows[i] = ROWS;
         }
+        // _tile_loadconfig 的内联汇编只声明读取 8 字节, 避免未使用 tile 的清零被优化掉
+        asm volatile("" : : "r"(&tileinfo) : "memory");
         _tile_loadconfig(&tileinfo);
     }
 
@@ -136,14 +138,8 @@ struct TestData {
     Matrix<int32_t> C01;
     Matrix<int32_t> C10;
     Matrix<int32_t> C11;
-    IntelAmxMatrixMultiply<int8_t, int32_t> multiply;
-
-    TestData()
-        : C00(16, 16),
-          C01(16, 16),
-          C10(16, 16),
-          C11(16, 16),
-          multiply(IntelAmxMatrixMultiply<int8_t, int32_t>::Create()) {
+
+    TestData() : C00(16, 16), C01(16, 16), C10(16, 16), C11(16, 16) {
         VA0.reserve(16);
         VB0.reserve(16);
         VA1.reserve(16);
@@ -153,13 +149,18 @@ struct TestData {
 
 void run_test(int thread_id, int iterations, TestData &data, double &result_time,
               double &result_gflops) {
+    // tile 配置是线程私有的状态, 必须在执行计算的线程里申请权限并加载配置
+    auto multiply = IntelAmxMatrixMultiply<int8_t, int32_t>::Create();
+
     auto t0 = std::chrono::high_resolution_clock::now();
     for (int i = 0; i < iterations; i++) {
-        data.multiply.MatrixMultiply(data.VA0, data.VA1, data.VB0, data.VB1, data.C00, data.C01,
-                                     data.C10, data.C11);
+        multiply.MatrixMultiply(data.VA0, data.VA1, data.VB0, data.VB1, data.C00, data.C01,
+                                data.C10, data.C11);
     }
     auto t1 = std::chrono::high_resolution_clock::now();
 
+    multiply.TileRelease();
+
     auto cost_time = static_cast<double>((t1 - t0).count());
     auto ops_per_matmul = int64_t(16) * 64 * 16 * 2 * 4 * 16;  // 2097152
     auto total_flops = static_cast<double>(ops_per_matmul * iterations);
@@ -223,6 +224,5 @@ int main() {
     auto total_gflops = total_flops / (total_time * 1e9);
     std::cout << "总性能: " << std::fixed << std::setprecision(4) << total_gflops << " GFLOPS\n";
 
-    for (auto &data : thread_data) data.multiply.TileRelease();
     return 0;
 }
\ No newline at end of file